@@ -1,2 +1,79 @@
+#include <stddef.h>
+
 int rest_server();
 
+/*
+ * Allocates size bytes that live until the reply to the request being
+ * served is sent. Meant for diag functions: a result built entirely from
+ * this memory is not freed by the server. Returns NULL outside of a
+ * request, or if the request arena is full or disabled.
+ */
+void* rest_request_alloc(size_t size);
+
+struct rest_memory_usage {
+    // memory the server set aside at init
+    size_t budget;
+    // in use by the request being served
+    size_t used;
+    // highest use so far
+    size_t peak;
+};
+
+/* Reports how much of the server's memory is in use */
+void rest_memory_usage(struct rest_memory_usage* usage);
+
+struct json_value;
+
+/* Types a parameter can be decoded into */
+enum rest_field_type {
+    /* int64_t, from an integer */
+    REST_FIELD_INT,
+    /* bool, from true or false */
+    REST_FIELD_BOOL,
+    /* const char*, borrowed from the request until the reply is sent */
+    REST_FIELD_STRING,
+};
+
+/* A member of a parameters object and where it goes in the C struct */
+struct rest_field {
+    const char* name;
+    enum rest_field_type type;
+    size_t offset;
+};
+
+/* Field named after member of struct params */
+#define REST_FIELD(type, params, member) \
+    { #member, type, offsetof(params, member) }
+
+typedef int (*rest_function_t)(const void* params, struct json_value** result);
+
+/*
+ * Registers function under name, ahead of the diag functions. Its
+ * parameters are decoded straight from the request into a zeroed struct of
+ * params_size bytes following the field_count entries of fields, without
+ * building a json_value tree. Missing and null members keep their zero,
+ * unknown members are ignored. If a member does not have the type of its
+ * field, or the parameters are not an object, function is not called and
+ * its output is null. Has to be called before rest_server(). Returns 0,
+ * or -1 if the table of functions or of interned names is full.
+ */
+int rest_register_function(const char* name, rest_function_t function,
+                           const struct rest_field* fields, size_t field_count,
+                           size_t params_size);
+
+/*
+ * Parameter lookup for diag functions. Returns the value of the first
+ * member named key of object, or NULL if there is none or object is not an
+ * object. Objects with many members get a hash index on their first
+ * lookup, kept on the side until the reply is sent, so repeated lookups
+ * in a large parameter map are O(1). The index lives in the request arena,
+ * or on the heap when there is none; in static mode, a lookup that does not
+ * fit in the arena is a linear search. The object must not be modified
+ * while it is being looked up in.
+ */
+struct json_value* json_object_get(const struct json_value* object, const char* key);
+/* Integer member key of object, or fallback if missing or not an integer */
+long long json_object_get_int(const struct json_value* object, const char* key,
+                              long long fallback);
+/* String member key of object, or NULL if missing or not a string */
+const char* json_object_get_string(const struct json_value* object, const char* key);
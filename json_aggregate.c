@@ -0,0 +1,230 @@
+#include "json_aggregate.h"
+#include <string.h>
+
+static const char* const op_names[] = {
+    [AGGREGATE_MIN] = "min",
+    [AGGREGATE_MAX] = "max",
+    [AGGREGATE_SUM] = "sum",
+    [AGGREGATE_AVG] = "avg",
+    [AGGREGATE_COUNT] = "count",
+    [AGGREGATE_TOP] = "top",
+};
+
+static bool is_name_char(char c) {
+    return c != '/' && c != ':' && c != ',';
+}
+
+// Reads the operator text[0, len) into aggregate
+static bool read_op(const char* text, size_t len, struct json_aggregate* aggregate) {
+    for (size_t op = 0; op < AGGREGATE_TOP; op++) {
+        if (strlen(op_names[op]) == len && memcmp(text, op_names[op], len) == 0) {
+            aggregate->op = op;
+            return true;
+        }
+    }
+    if (len < 4 || memcmp(text, "top", 3) != 0)
+        return false;
+    size_t top = 0;
+    for (size_t i = 3; i < len; i++) {
+        if (text[i] < '0' || text[i] > '9' || top > JSON_AGGREGATE_TOP_MAX)
+            return false;
+        top = top * 10 + text[i] - '0';
+    }
+    aggregate->op = AGGREGATE_TOP;
+    aggregate->top = top;
+    return top > 0 && top <= JSON_AGGREGATE_TOP_MAX;
+}
+
+// Reads the spec text[0, len) into aggregate
+static bool read_spec(char* text, size_t len, struct json_aggregate* aggregate) {
+    size_t pos = 0;
+    while (pos < len && is_name_char(text[pos]))
+        pos++;
+    if (pos == 0)
+        return false;
+    aggregate->output = text;
+    aggregate->output_len = pos;
+    aggregate->path = &text[pos];
+    aggregate->path_len = 0;
+    // the key starts after the output name and its separator
+    aggregate->key = &text[pos + 1];
+    if (pos < len && text[pos] == '/') {
+        aggregate->path = &text[++pos];
+        for (;;) {
+            size_t start = pos;
+            while (pos < len && is_name_char(text[pos]))
+                pos++;
+            if (pos == start)
+                return false;
+            if (pos == len || text[pos] != '/')
+                break;
+            pos++;
+        }
+        aggregate->path_len = &text[pos] - aggregate->path;
+    }
+    if (pos == len || text[pos] != ':')
+        return false;
+    pos++;
+    return read_op(&text[pos], len - pos, aggregate);
+}
+
+// Both passes of the parser. Returns the number of specs, or 0 if one is
+// malformed.
+static size_t parse(char* text, size_t len, struct json_aggregate* aggregates) {
+    size_t count = 0;
+    size_t pos = 0;
+    for (;;) {
+        size_t start = pos;
+        while (pos < len && text[pos] != ',')
+            pos++;
+        struct json_aggregate scratch;
+        struct json_aggregate* aggregate = aggregates != NULL ? &aggregates[count] : &scratch;
+        memset(aggregate, 0, sizeof *aggregate);
+        if (!read_spec(&text[start], pos - start, aggregate))
+            return 0;
+        if (aggregates != NULL)
+            text[pos] = '\0';
+        count++;
+        if (pos == len)
+            return count;
+        pos++;
+    }
+}
+
+size_t json_aggregate_count(const char* text, size_t len) {
+    // nothing is written while counting
+    return parse((char*) text, len, NULL);
+}
+
+void json_aggregate_parse(char* text, size_t len, struct json_aggregate* aggregates) {
+    parse(text, len, aggregates);
+}
+
+static void add(struct json_aggregate* aggregate, int64_t value) {
+    if (aggregate->count == 0 || value < aggregate->min)
+        aggregate->min = value;
+    if (aggregate->count == 0 || value > aggregate->max)
+        aggregate->max = value;
+    aggregate->count++;
+    // wraps around like the unsigned sum instead of overflowing
+    aggregate->sum = (int64_t) ((uint64_t) aggregate->sum + (uint64_t) value);
+    if (aggregate->op != AGGREGATE_TOP)
+        return;
+    // insertion into the k largest so far, kept in descending order
+    size_t len = aggregate->count <= aggregate->top ? aggregate->count : aggregate->top;
+    size_t i = len - 1;
+    if (aggregate->count > aggregate->top && value <= aggregate->largest[i])
+        return;
+    while (i > 0 && aggregate->largest[i - 1] < value) {
+        aggregate->largest[i] = aggregate->largest[i - 1];
+        i--;
+    }
+    aggregate->largest[i] = value;
+}
+
+// Output trees come from the diag functions, so plain recursion is fine
+static void visit(struct json_aggregate* aggregate, const struct json_value* value,
+                  const char* path, size_t path_len) {
+    if (value == NULL)
+        return;
+    if (value->type == JSON_ARRAY) {
+        for (size_t i = 0; i < value->array->size; i++)
+            visit(aggregate, value->array->values[i], path, path_len);
+        return;
+    }
+    if (path_len == 0) {
+        if (value->type == JSON_INT)
+            add(aggregate, value->integer);
+        return;
+    }
+    if (value->type != JSON_OBJECT)
+        return;
+    size_t name_len = 0;
+    while (name_len < path_len && path[name_len] != '/')
+        name_len++;
+    size_t rest = name_len < path_len ? name_len + 1 : name_len;
+    for (const struct json_object* obj = value->object; obj != NULL; obj = obj->next) {
+        if (strncmp(obj->key, path, name_len) == 0 && obj->key[name_len] == '\0') {
+            visit(aggregate, obj->value, &path[rest], path_len - rest);
+            return;
+        }
+    }
+}
+
+static void set_int(struct json_value* value, int64_t integer) {
+    value->type = JSON_INT;
+    value->integer = integer;
+}
+
+// Builds the result of the pass of aggregate in nodes
+static void build(const struct json_aggregate* aggregate, struct json_aggregate_nodes* nodes) {
+    struct json_value* value = &nodes->value;
+    value->type = JSON_NULL;
+    switch (aggregate->op) {
+        case AGGREGATE_MIN:
+            if (aggregate->count > 0)
+                set_int(value, aggregate->min);
+            break;
+        case AGGREGATE_MAX:
+            if (aggregate->count > 0)
+                set_int(value, aggregate->max);
+            break;
+        case AGGREGATE_SUM:
+            set_int(value, aggregate->sum);
+            break;
+        case AGGREGATE_AVG:
+            if (aggregate->count > 0)
+                set_int(value, aggregate->sum / (int64_t) aggregate->count);
+            break;
+        case AGGREGATE_COUNT:
+            set_int(value, aggregate->count);
+            break;
+        case AGGREGATE_TOP:
+            value->type = JSON_ARRAY;
+            value->array = &nodes->array;
+            nodes->array.values = nodes->elements;
+            nodes->array.size = aggregate->count < aggregate->top ? aggregate->count
+                                                                  : aggregate->top;
+            for (size_t i = 0; i < nodes->array.size; i++) {
+                nodes->elements[i] = &nodes->element_values[i];
+                set_int(&nodes->element_values[i], aggregate->largest[i]);
+            }
+            break;
+    }
+    nodes->member.key = aggregate->key;
+    nodes->member.value = value;
+    nodes->member.next = NULL;
+}
+
+static bool is_for(const struct json_aggregate* aggregate, const char* name) {
+    return strncmp(name, aggregate->output, aggregate->output_len) == 0
+        && name[aggregate->output_len] == '\0';
+}
+
+size_t json_aggregate_matches(const struct json_aggregate* aggregates, size_t count,
+                              const char* name) {
+    size_t matches = 0;
+    for (size_t i = 0; i < count; i++)
+        matches += is_for(&aggregates[i], name);
+    return matches;
+}
+
+void json_aggregate_output(struct json_aggregate* aggregates, size_t count,
+                           const char* name, const struct json_value* value,
+                           struct json_value* object, struct json_aggregate_nodes* nodes) {
+    object->type = JSON_OBJECT;
+    object->object = NULL;
+    struct json_object** tail = &object->object;
+    for (size_t i = 0; i < count; i++) {
+        struct json_aggregate* aggregate = &aggregates[i];
+        if (!is_for(aggregate, name))
+            continue;
+        aggregate->count = 0;
+        aggregate->sum = 0;
+        visit(aggregate, value, aggregate->path, aggregate->path_len);
+        build(aggregate, nodes);
+        *tail = &nodes->member;
+        tail = &nodes->member.next;
+        nodes++;
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef JSON_AGGREGATE_H_
+#define JSON_AGGREGATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <uk/json_ir.h>
+
+// Largest k of a top-k aggregate
+#define JSON_AGGREGATE_TOP_MAX 16
+
+enum json_aggregate_op {
+    AGGREGATE_MIN,
+    AGGREGATE_MAX,
+    AGGREGATE_SUM,
+    // truncated towards zero, the IR has no fractions
+    AGGREGATE_AVG,
+    AGGREGATE_COUNT,
+    // the k largest, in descending order
+    AGGREGATE_TOP,
+};
+
+/*
+ * Reduction of the integers an output holds at a path, in place of the
+ * output. A spec is the name of the output, the '/' separated members
+ * below it, and the operator: "threads/cpu:max", "heap/size:sum",
+ * "threads/cpu:top5", "counts:avg". Arrays along the path, and at its end,
+ * are iterated, so "threads/cpu" is the cpu member of every element of
+ * threads. Values that are not integers are left out.
+ *
+ * The result goes in an object replacing the output, under the spec
+ * without the output name: {"threads":{"cpu:max":9,"cpu:top2":[9,7]}}.
+ * It is built in nodes the caller provides for each output, so outputs
+ * sharing a name each get their own; nothing is allocated here.
+ */
+struct json_aggregate {
+    // borrowed from the spec text
+    const char* output;
+    size_t output_len;
+    const char* path;
+    size_t path_len;
+    enum json_aggregate_op op;
+    // k of AGGREGATE_TOP
+    size_t top;
+    // '\0' terminated in the spec text
+    char* key;
+
+    // state of the pass
+    size_t count;
+    int64_t sum;
+    int64_t min;
+    int64_t max;
+    int64_t largest[JSON_AGGREGATE_TOP_MAX];
+};
+
+// Nodes of the result of one aggregate for one output
+struct json_aggregate_nodes {
+    struct json_value value;
+    struct json_object member;
+    struct json_array array;
+    struct json_value* elements[JSON_AGGREGATE_TOP_MAX];
+    struct json_value element_values[JSON_AGGREGATE_TOP_MAX];
+};
+
+// Number of comma separated specs in text, or 0 if one is malformed
+size_t json_aggregate_count(const char* text, size_t len);
+// Reads the specs counted with json_aggregate_count() into aggregates.
+// Their keys are terminated in place, text[len] has to be writable.
+void json_aggregate_parse(char* text, size_t len, struct json_aggregate* aggregates);
+// Number of aggregates of output name
+size_t json_aggregate_matches(const struct json_aggregate* aggregates, size_t count,
+                              const char* name);
+// Evaluates the aggregates of output name over its value, each in a single
+// pass, and builds the object of their results in object, which replaces
+// the output. nodes has room for the json_aggregate_matches() of name.
+void json_aggregate_output(struct json_aggregate* aggregates, size_t count,
+                           const char* name, const struct json_value* value,
+                           struct json_value* object, struct json_aggregate_nodes* nodes);
+
+#endif
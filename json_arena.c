@@ -0,0 +1,53 @@
+#include "json_arena.h"
+#include <stdint.h>
+#include <string.h>
+
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+void json_arena_init(struct json_arena* arena, void* memory, size_t size) {
+    // align the base so every allocation is aligned
+    uintptr_t start = ((uintptr_t) memory + ARENA_ALIGN - 1) & ~(uintptr_t) (ARENA_ALIGN - 1);
+    size_t skip = start - (uintptr_t) memory;
+    arena->base = (char*) start;
+    arena->size = size > skip ? size - skip : 0;
+    arena->used = 0;
+    arena->last = 0;
+    arena->peak = 0;
+}
+
+void* json_arena_alloc(struct json_arena* arena, size_t size) {
+    size_t start = (arena->used + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (start > arena->size || size > arena->size - start)
+        return NULL;
+    arena->last = start;
+    arena->used = start + size;
+    if (arena->used > arena->peak)
+        arena->peak = arena->used;
+    return &arena->base[start];
+}
+
+void* json_arena_realloc(struct json_arena* arena, void* ptr, size_t old_size, size_t new_size) {
+    if (ptr == NULL)
+        return json_arena_alloc(arena, new_size);
+    if ((char*) ptr == &arena->base[arena->last]) {
+        if (new_size > arena->size - arena->last)
+            return NULL;
+        arena->used = arena->last + new_size;
+        if (arena->used > arena->peak)
+            arena->peak = arena->used;
+        return ptr;
+    }
+    void* block = json_arena_alloc(arena, new_size);
+    if (block != NULL)
+        memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+    return block;
+}
+
+void json_arena_reset(struct json_arena* arena) {
+    arena->used = 0;
+    arena->last = 0;
+}
+
+bool json_arena_owns(const struct json_arena* arena, const void* ptr) {
+    return (const char*) ptr >= arena->base && (const char*) ptr < &arena->base[arena->size];
+}
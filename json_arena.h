@@ -0,0 +1,33 @@
+#ifndef JSON_ARENA_H_
+#define JSON_ARENA_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Bump allocator over one fixed block of memory. Everything allocated
+ * from it is released at once by json_arena_reset(), which is O(1): a
+ * request's parse tree, outputs and reply buffer never have to be walked
+ * to be freed, and they cannot fragment the heap.
+ */
+struct json_arena {
+    char* base;
+    size_t size;
+    size_t used;
+    // start of the last allocation, which can be grown in place
+    size_t last;
+    // highest use since json_arena_init()
+    size_t peak;
+};
+
+void json_arena_init(struct json_arena* arena, void* memory, size_t size);
+// Returns size bytes aligned for any type, or NULL if the arena is full.
+void* json_arena_alloc(struct json_arena* arena, size_t size);
+// Grows or shrinks ptr, in place if it is the last allocation. Returns NULL
+// if the arena is full, leaving ptr as it was.
+void* json_arena_realloc(struct json_arena* arena, void* ptr, size_t old_size, size_t new_size);
+void json_arena_reset(struct json_arena* arena);
+// True if ptr was allocated from arena
+bool json_arena_owns(const struct json_arena* arena, const void* ptr);
+
+#endif
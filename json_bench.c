@@ -0,0 +1,97 @@
+#include "json_bench.h"
+#include "json_writer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <uk/plat/time.h>
+#include <uk/json_ir.h>
+
+#define BENCH_ROUNDS 1000
+#define BENCH_THREADS 64
+#define BENCH_BUCKETS 512
+#define BENCH_BUFLEN (64 * 1024)
+
+static char bench_buff[BENCH_BUFLEN];
+
+static struct json_value* int_value(int64_t integer) {
+    struct json_value* value = create_json_value(JSON_INT);
+    value->integer = integer;
+    return value;
+}
+
+static struct json_value* int_array(size_t size, uint64_t* seed) {
+    struct json_value* value = create_json_value(JSON_ARRAY);
+    value->array = calloc(1, sizeof(struct json_array));
+    value->array->values = calloc(size, sizeof(struct json_value*));
+    value->array->size = size;
+    for (size_t i = 0; i < size; i++) {
+        // xorshift, spread over all magnitudes
+        *seed ^= *seed << 13;
+        *seed ^= *seed >> 7;
+        *seed ^= *seed << 17;
+        value->array->values[i] = int_value(*seed >> (*seed % 64));
+    }
+    return value;
+}
+
+// {"threads": [{"id": .., "switches": .., ...}, ...], "histogram": [...]}
+static struct json_value* bench_tree(void) {
+    static const char* counters[] = {
+        "id", "switches", "yields", "wakeups", "runtime_ns", "stack_used", "allocs", "frees",
+    };
+    uint64_t seed = 88172645463325252ull;
+    struct json_value* threads = create_json_value(JSON_ARRAY);
+    threads->array = calloc(1, sizeof(struct json_array));
+    threads->array->values = calloc(BENCH_THREADS, sizeof(struct json_value*));
+    threads->array->size = BENCH_THREADS;
+    for (size_t i = 0; i < BENCH_THREADS; i++) {
+        struct json_value* thread = create_json_value(JSON_OBJECT);
+        struct json_value* values = int_array(sizeof counters / sizeof *counters, &seed);
+        for (size_t j = 0; j < sizeof counters / sizeof *counters; j++)
+            json_object_insert(thread, counters[j], values->array->values[j]);
+        values->array->size = 0;
+        free_json_value(values);
+        threads->array->values[i] = thread;
+    }
+    struct json_value* root = create_json_value(JSON_OBJECT);
+    json_object_insert(root, "threads", threads);
+    json_object_insert(root, "histogram", int_array(BENCH_BUCKETS, &seed));
+    return root;
+}
+
+static void report(const char* name, __nsec start, size_t bytes) {
+    __nsec ns = (ukplat_monotonic_clock() - start) / BENCH_ROUNDS;
+    printf("%-16s %8lu ns/round %6lu bytes %6lu MB/s\n", name, (unsigned long) ns,
+           (unsigned long) bytes, (unsigned long) (ns ? bytes * 1000 / ns : 0));
+}
+
+void json_bench(void) {
+    struct json_value* tree = bench_tree();
+    size_t size = 0;
+
+    __nsec start = ukplat_monotonic_clock();
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+        size = to_json(bench_buff, BENCH_BUFLEN, tree);
+    report("to_json", start, size);
+
+    start = ukplat_monotonic_clock();
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+        size = json_serialize(bench_buff, BENCH_BUFLEN, tree);
+    report("json_serialize", start, size);
+
+    free_json_value(tree);
+
+    // rates and percentages
+    char out[JSON_NUMBER_CHARS];
+    size = 0;
+    start = ukplat_monotonic_clock();
+    for (int i = 0; i < BENCH_ROUNDS * 100; i++)
+        size += snprintf(out, sizeof out, "%.17g", i * 0.0137);
+    report("%.17g (x100)", start, size / 100);
+
+    size = 0;
+    start = ukplat_monotonic_clock();
+    for (int i = 0; i < BENCH_ROUNDS * 100; i++)
+        size += json_write_double(out, i * 0.0137);
+    report("grisu2 (x100)", start, size / 100);
+}
@@ -0,0 +1,9 @@
+#ifndef JSON_BENCH_H_
+#define JSON_BENCH_H_
+
+// Times json_serialize() against to_json() on integer heavy outputs shaped
+// like the diag results (per-thread counters, memory histograms) and the
+// double formatter against printf, and prints the results.
+void json_bench(void);
+
+#endif
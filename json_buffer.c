@@ -0,0 +1,54 @@
+#include "json_buffer.h"
+#include <stdlib.h>
+#include <stddef.h>
+
+// Prefix of every buffer, the returned memory starts right after it
+union json_buffer_header {
+    struct {
+        union json_buffer_header* next;
+        size_t size_class;
+    };
+    max_align_t align;
+};
+
+static union json_buffer_header* free_buffers[JSON_BUFFER_CLASSES];
+static size_t free_count[JSON_BUFFER_CLASSES];
+
+static size_t size_class(size_t size) {
+    size_t cls = 0;
+    while (cls < JSON_BUFFER_CLASSES && (size_t) JSON_BUFFER_MIN << cls < size)
+        cls++;
+    return cls;
+}
+
+char* json_buffer_get(size_t size) {
+    size_t cls = size_class(size);
+    union json_buffer_header* header;
+    if (cls < JSON_BUFFER_CLASSES && free_buffers[cls] != NULL) {
+        header = free_buffers[cls];
+        free_buffers[cls] = header->next;
+        free_count[cls]--;
+        return (char*) (header + 1);
+    }
+    if (cls < JSON_BUFFER_CLASSES)
+        size = (size_t) JSON_BUFFER_MIN << cls;
+    header = malloc(sizeof(union json_buffer_header) + size);
+    if (header == NULL)
+        return NULL;
+    header->size_class = cls;
+    return (char*) (header + 1);
+}
+
+void json_buffer_put(char* buff) {
+    if (buff == NULL)
+        return;
+    union json_buffer_header* header = (union json_buffer_header*) buff - 1;
+    size_t cls = header->size_class;
+    if (cls == JSON_BUFFER_CLASSES || free_count[cls] == JSON_BUFFER_KEEP) {
+        free(header);
+        return;
+    }
+    header->next = free_buffers[cls];
+    free_buffers[cls] = header;
+    free_count[cls]++;
+}
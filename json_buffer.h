@@ -0,0 +1,19 @@
+#ifndef JSON_BUFFER_H_
+#define JSON_BUFFER_H_
+
+#include <stddef.h>
+
+// Pooled buffers come in power of two size classes from JSON_BUFFER_MIN to
+// JSON_BUFFER_MIN << (JSON_BUFFER_CLASSES - 1) bytes. Larger requests are
+// served by malloc() directly.
+#define JSON_BUFFER_MIN 256
+#define JSON_BUFFER_CLASSES 9
+// Released buffers kept per size class, the rest are freed
+#define JSON_BUFFER_KEEP 4
+
+// Returns a buffer of at least size bytes, or NULL if out of memory.
+char* json_buffer_get(size_t size);
+// Returns buff to the pool. buff may be NULL.
+void json_buffer_put(char* buff);
+
+#endif
@@ -0,0 +1,65 @@
+#include "json_chars.h"
+#include <string.h>
+
+#define W JSON_CHAR_WS
+#define S JSON_CHAR_STRING
+#define N JSON_CHAR_NUMBER
+#define DN (JSON_CHAR_DIGIT | JSON_CHAR_NUMBER)
+#define WS (JSON_CHAR_WS | JSON_CHAR_STRING)
+
+const uint8_t json_char_class[256] = {
+    S,  S,  S,  S,  S,  S,  S,  S,  S,  WS, WS, S,  S,  WS, S,  S, // 00
+    S,  S,  S,  S,  S,  S,  S,  S,  S,  S,  S,  S,  S,  S,  S,  S, // 10
+    W,  0,  S,  0,  0,  0,  0,  0,  0,  0,  0,  N,  0,  N,  N,  0, // 20
+    DN, DN, DN, DN, DN, DN, DN, DN, DN, DN, 0,  0,  0,  0,  0,  0, // 30
+    0,  0,  0,  0,  0,  N,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 40
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  S,  0,  0,  0, // 50
+    0,  0,  0,  0,  0,  N,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 60
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 70
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 80
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // 90
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // A0
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // B0
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // C0
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // D0
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // E0
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // F0
+};
+
+#undef W
+#undef S
+#undef N
+#undef DN
+#undef WS
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define ONES UINT64_C(0x0101010101010101)
+#define HIGHS UINT64_C(0x8080808080808080)
+
+// High bit set in every byte of word equal to c, exact for all bytes
+static inline uint64_t bytes_equal(uint64_t word, char c) {
+    uint64_t x = word ^ (ONES * (unsigned char) c);
+    return ~(((x & ~HIGHS) + ~HIGHS) | x) & HIGHS;
+}
+#endif
+
+size_t json_skip_ws(const char* data, size_t len, size_t pos) {
+    // most values are not preceded by whitespace at all
+    if (pos < len && !json_is_ws(data[pos]))
+        return pos;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // indentation comes in runs, skip it eight bytes at a time
+    for (; pos + 8 <= len; pos += 8) {
+        uint64_t word;
+        memcpy(&word, &data[pos], sizeof word);
+        uint64_t ws = bytes_equal(word, ' ') | bytes_equal(word, '\n')
+            | bytes_equal(word, '\r') | bytes_equal(word, '\t');
+        uint64_t other = ~ws & HIGHS;
+        if (other != 0)
+            return pos + __builtin_ctzll(other) / 8;
+    }
+#endif
+    while (pos < len && json_is_ws(data[pos]))
+        pos++;
+    return pos;
+}
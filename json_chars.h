@@ -0,0 +1,62 @@
+#ifndef JSON_CHARS_H_
+#define JSON_CHARS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Character classes of json_char_class[], following RFC 8259 rather than
+// the C locale: only space, \t, \n and \r are whitespace.
+enum json_char_class {
+    JSON_CHAR_WS = 1,
+    JSON_CHAR_DIGIT = 2,
+    // can appear in a number: digits, '+', '-', '.', 'e' and 'E'
+    JSON_CHAR_NUMBER = 4,
+    // ends a plain run in a string: '"', '\\' and control characters
+    JSON_CHAR_STRING = 8,
+};
+
+extern const uint8_t json_char_class[256];
+
+static inline bool json_is_ws(char c) {
+    return json_char_class[(unsigned char) c] & JSON_CHAR_WS;
+}
+
+static inline bool json_is_digit(char c) {
+    return json_char_class[(unsigned char) c] & JSON_CHAR_DIGIT;
+}
+
+// Length of the literal starting with c: 4 for true and null, 5 for false
+// and 0 if c does not start one
+static inline size_t json_literal_len(char c) {
+    return c == 'f' ? 5 : c == 't' || c == 'n' ? 4 : 0;
+}
+
+// True if data starts with the literal true, false or null. data has to
+// hold json_literal_len(data[0]) bytes. The literal is checked with one
+// unaligned 4-byte compare, past the 'f' for false.
+static inline bool json_literal_matches(const char* data) {
+    uint32_t word, literal;
+    switch (data[0]) {
+        case 't':
+            memcpy(&literal, "true", 4);
+            break;
+        case 'n':
+            memcpy(&literal, "null", 4);
+            break;
+        case 'f':
+            memcpy(&literal, "alse", 4);
+            data++;
+            break;
+        default:
+            return false;
+    }
+    memcpy(&word, data, 4);
+    return word == literal;
+}
+
+// Position of the first non-whitespace byte of data at or after pos, or len
+size_t json_skip_ws(const char* data, size_t len, size_t pos);
+
+#endif
@@ -0,0 +1,144 @@
+#include "json_index.h"
+#include <rest.h>
+#include <uk/json_ir.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Open addressing table of the members of one object. The json_object list
+ * itself is left as it is, the index only points into it.
+ */
+struct json_index {
+    const struct json_value* object;
+    // first member when the index was built, to notice a replaced list
+    const struct json_object* head;
+    struct json_object** slots;
+    size_t mask;
+#if !CONFIG_LIBUKDIAGREST_STATIC
+    // the slots came from malloc() rather than the request arena
+    bool heap;
+#endif
+};
+
+static struct json_index indexes[JSON_INDEX_SLOTS];
+static size_t next_victim;
+
+static uint32_t hash_key(const char* key) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (; *key != '\0'; key++)
+        hash = (hash ^ (unsigned char) *key) * 16777619u;
+    return hash;
+}
+
+static void drop_index(struct json_index* index) {
+#if !CONFIG_LIBUKDIAGREST_STATIC
+    if (index->heap)
+        free(index->slots);
+#endif
+    memset(index, 0, sizeof *index);
+}
+
+void json_index_clear(void) {
+    for (size_t i = 0; i < JSON_INDEX_SLOTS; i++)
+        drop_index(&indexes[i]);
+    next_victim = 0;
+}
+
+static struct json_object** build_slots(struct json_index* index, size_t capacity) {
+    size_t size = capacity * sizeof *index->slots;
+    index->slots = rest_request_alloc(size);
+#if !CONFIG_LIBUKDIAGREST_STATIC
+    // the static build stays off the heap and falls back to a linear search
+    index->heap = index->slots == NULL;
+    if (index->heap)
+        index->slots = malloc(size);
+#endif
+    if (index->slots != NULL)
+        memset(index->slots, 0, size);
+    return index->slots;
+}
+
+static struct json_index* find_index(const struct json_value* object) {
+    for (size_t i = 0; i < JSON_INDEX_SLOTS; i++) {
+        if (indexes[i].object == object) {
+            if (indexes[i].head == object->object)
+                return &indexes[i];
+            drop_index(&indexes[i]);
+        }
+    }
+    return NULL;
+}
+
+// Indexes the count members of object. NULL if it cannot be allocated.
+static struct json_index* build_index(const struct json_value* object, size_t count) {
+    struct json_index* index = &indexes[next_victim];
+    next_victim = (next_victim + 1) % JSON_INDEX_SLOTS;
+    drop_index(index);
+
+    // at most half full
+    size_t capacity = 16;
+    while (capacity < 2 * count)
+        capacity *= 2;
+    if (build_slots(index, capacity) == NULL)
+        return NULL;
+    index->object = object;
+    index->head = object->object;
+    index->mask = capacity - 1;
+    for (struct json_object* obj = object->object; obj != NULL; obj = obj->next) {
+        size_t slot = hash_key(obj->key) & index->mask;
+        while (index->slots[slot] != NULL && strcmp(index->slots[slot]->key, obj->key) != 0)
+            slot = (slot + 1) & index->mask;
+        // duplicate keys resolve to the first member, like a linear search
+        if (index->slots[slot] == NULL)
+            index->slots[slot] = obj;
+    }
+    return index;
+}
+
+static struct json_value* linear_get(const struct json_value* object, const char* key) {
+    for (struct json_object* obj = object->object; obj != NULL; obj = obj->next) {
+        if (strcmp(obj->key, key) == 0)
+            return obj->value;
+    }
+    return NULL;
+}
+
+struct json_value* json_object_get(const struct json_value* object, const char* key) {
+    if (object == NULL || object->type != JSON_OBJECT)
+        return NULL;
+
+    struct json_index* index = find_index(object);
+    if (index == NULL) {
+        size_t count = 0;
+        for (struct json_object* obj = object->object; obj != NULL; obj = obj->next)
+            count++;
+        if (count < JSON_INDEX_MIN)
+            return linear_get(object, key);
+        index = build_index(object, count);
+        if (index == NULL)
+            return linear_get(object, key);
+    }
+    size_t slot = hash_key(key) & index->mask;
+    for (; index->slots[slot] != NULL; slot = (slot + 1) & index->mask) {
+        if (strcmp(index->slots[slot]->key, key) == 0)
+            return index->slots[slot]->value;
+    }
+    return NULL;
+}
+
+long long json_object_get_int(const struct json_value* object, const char* key, long long fallback) {
+    struct json_value* value = json_object_get(object, key);
+    if (value == NULL || value->type != JSON_INT)
+        return fallback;
+    return value->integer;
+}
+
+const char* json_object_get_string(const struct json_value* object, const char* key) {
+    struct json_value* value = json_object_get(object, key);
+    if (value == NULL || value->type != JSON_STRING)
+        return NULL;
+    return value->string;
+}
@@ -0,0 +1,13 @@
+#ifndef JSON_INDEX_H_
+#define JSON_INDEX_H_
+
+// Objects with fewer members are searched linearly
+#define JSON_INDEX_MIN 8
+// Objects that can have an index at the same time
+#define JSON_INDEX_SLOTS 16
+
+// Drops all indexes, they must not outlive the trees they were built for.
+// Called by the server after each request.
+void json_index_clear(void);
+
+#endif
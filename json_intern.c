@@ -0,0 +1,55 @@
+#include "json_intern.h"
+#include <stdint.h>
+#include <string.h>
+
+static const char* slots[JSON_INTERN_SLOTS];
+static size_t count;
+// the canonical copies, each '\0' terminated
+static char strings[JSON_INTERN_BYTES];
+static size_t strings_used;
+
+static uint32_t hash_key(const char* key, size_t len) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ (unsigned char) key[i]) * 16777619u;
+    return hash;
+}
+
+// Slot holding key, or the empty slot where it would go
+static size_t find_slot(const char* key, size_t len) {
+    size_t slot = hash_key(key, len) & (JSON_INTERN_SLOTS - 1);
+    while (slots[slot] != NULL) {
+        if (strncmp(slots[slot], key, len) == 0 && slots[slot][len] == '\0')
+            return slot;
+        slot = (slot + 1) & (JSON_INTERN_SLOTS - 1);
+    }
+    return slot;
+}
+
+const char* json_intern_find(const char* key, size_t len) {
+    if (len > JSON_INTERN_MAX_LEN)
+        return NULL;
+    return slots[find_slot(key, len)];
+}
+
+const char* json_intern(const char* key, size_t len) {
+    if (len > JSON_INTERN_MAX_LEN)
+        return NULL;
+    size_t slot = find_slot(key, len);
+    if (slots[slot] != NULL)
+        return slots[slot];
+    if (count == JSON_INTERN_MAX || strings_used + len + 1 > JSON_INTERN_BYTES)
+        return NULL;
+    char* copy = &strings[strings_used];
+    memcpy(copy, key, len);
+    copy[len] = '\0';
+    strings_used += len + 1;
+    slots[slot] = copy;
+    count++;
+    return copy;
+}
+
+bool json_intern_owns(const char* string) {
+    return string >= strings && string < &strings[JSON_INTERN_BYTES];
+}
@@ -0,0 +1,34 @@
+#ifndef JSON_INTERN_H_
+#define JSON_INTERN_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Table of canonical, immutable copies of object keys. Function names are
+ * interned when they are registered, and the parsers intern the keys of
+ * requests while there is room, so repeated keys are neither allocated
+ * nor copied and can be compared by pointer. The table and its strings
+ * live in static memory that is never released; once it is full, keys not
+ * in it are allocated as before.
+ *
+ * The table is not locked and must only be used by the server thread.
+ * The sampler thread (rest_sampler.h) compares names with strcmp().
+ */
+
+#define JSON_INTERN_SLOTS 512
+// Keys are only learned while the table is at most half full
+#define JSON_INTERN_MAX (JSON_INTERN_SLOTS / 2)
+#define JSON_INTERN_BYTES 8192
+// Longer keys are not interned
+#define JSON_INTERN_MAX_LEN 64
+
+// Canonical copy of the len bytes of key, interned if they are not yet and
+// there is room, or NULL
+const char* json_intern(const char* key, size_t len);
+// Canonical copy of key if it is interned, or NULL
+const char* json_intern_find(const char* key, size_t len);
+// True if string is a canonical copy, which must not be freed
+bool json_intern_owns(const char* string);
+
+#endif
@@ -0,0 +1,190 @@
+#include "json_lazy.h"
+#include "json_parser.h"
+#include "json_string.h"
+#include "json_chars.h"
+#include "json_pool.h"
+#include "json_arena.h"
+#include <uk/json_ir.h>
+#include <string.h>
+
+static struct json_value arena_error = { .type = JSON_ERROR };
+
+static void* resize(struct json_lazy* lazy, void* ptr, size_t old_size, size_t new_size) {
+    void* block;
+    if (lazy->arena != NULL)
+        block = json_arena_realloc(lazy->arena, ptr, old_size, new_size);
+    else
+        block = json_pool_realloc(ptr, old_size, new_size);
+    if (block == NULL)
+        lazy->out_of_memory = true;
+    return block;
+}
+
+// Position after the closing quote of the string whose contents start at
+// pos, or 0 if it does not end before len
+static size_t skip_string(const char* data, size_t len, size_t pos) {
+    while (pos < len) {
+        pos += json_string_run(&data[pos], len - pos);
+        if (pos == len)
+            return 0;
+        if (data[pos] == '"')
+            return pos + 1;
+        // the escaped character, or a control character left to the parser
+        pos += data[pos] == '\\' ? 2 : 1;
+    }
+    return 0;
+}
+
+size_t json_skip_value(const char* data, size_t len, size_t pos) {
+    size_t depth = 0;
+    while (pos < len) {
+        char c = data[pos];
+        if (c == '"') {
+            pos = skip_string(data, len, pos + 1);
+            if (pos == 0 || depth == 0)
+                return pos;
+        } else if (c == '{' || c == '[') {
+            depth++;
+            pos++;
+        } else if (c == '}' || c == ']') {
+            if (depth == 0)
+                return pos;
+            pos++;
+            if (--depth == 0)
+                return pos;
+        } else if (depth == 0 && (c == ',' || json_is_ws(c))) {
+            return pos;
+        } else {
+            pos++;
+        }
+    }
+    return depth == 0 ? pos : 0;
+}
+
+static struct json_value* new_object(struct json_lazy* lazy) {
+    struct json_value* object;
+    if (lazy->arena == NULL) {
+        object = json_pool_value(JSON_OBJECT);
+    } else {
+        object = json_arena_alloc(lazy->arena, sizeof *object);
+        if (object != NULL)
+            object->type = JSON_OBJECT;
+    }
+    if (object == NULL)
+        lazy->out_of_memory = true;
+    else
+        object->object = NULL;
+    return object;
+}
+
+static struct json_object* new_member(struct json_lazy* lazy) {
+    struct json_object* member;
+    if (lazy->arena == NULL)
+        member = json_pool_object();
+    else
+        member = json_arena_alloc(lazy->arena, sizeof *member);
+    if (member == NULL)
+        lazy->out_of_memory = true;
+    return member;
+}
+
+static bool add_range(struct json_lazy* lazy, char* data, size_t len) {
+    if (lazy->size == lazy->capacity) {
+        size_t capacity = lazy->capacity == 0 ? 8 : 2 * lazy->capacity;
+        struct json_lazy_range* ranges = resize(lazy, lazy->ranges,
+                                                lazy->capacity * sizeof *ranges,
+                                                capacity * sizeof *ranges);
+        if (ranges == NULL)
+            return false;
+        lazy->ranges = ranges;
+        lazy->capacity = capacity;
+    }
+    lazy->ranges[lazy->size].data = data;
+    lazy->ranges[lazy->size].len = len;
+    lazy->size++;
+    return true;
+}
+
+// Indexes the members of the object whose '{' is at pos, appending them
+// to root. Returns false if the input is malformed or memory ran out.
+static bool index_members(char* data, size_t len, size_t pos, struct json_value* root,
+                          struct json_lazy* lazy) {
+    struct json_object** tail = &root->object;
+    pos = json_skip_ws(data, len, pos + 1);
+    if (pos < len && data[pos] == '}')
+        return json_skip_ws(data, len, pos + 1) == len;
+
+    for (;;) {
+        if (pos == len || data[pos] != '"')
+            return false;
+        char* key = &data[pos + 1];
+        pos = json_string_insitu(data, len, pos + 1);
+        if (pos == 0)
+            return false;
+        pos = json_skip_ws(data, len, pos);
+        if (pos == len || data[pos] != ':')
+            return false;
+        size_t start = json_skip_ws(data, len, pos + 1);
+        pos = json_skip_value(data, len, start);
+        if (pos <= start)
+            return false;
+
+        // linked right away so it is released with root on failure
+        struct json_object* member = new_member(lazy);
+        if (member == NULL)
+            return false;
+        member->key = key;
+        member->value = NULL;
+        member->next = NULL;
+        *tail = member;
+        tail = &member->next;
+        if (!add_range(lazy, &data[start], pos - start))
+            return false;
+
+        pos = json_skip_ws(data, len, pos);
+        if (pos == len)
+            return false;
+        if (data[pos] == '}')
+            return json_skip_ws(data, len, pos + 1) == len;
+        if (data[pos] != ',')
+            return false;
+        pos = json_skip_ws(data, len, pos + 1);
+    }
+}
+
+struct json_value* parse_json_lazy(char* data, const size_t len, struct json_arena* arena,
+                                   struct json_lazy* lazy) {
+    memset(lazy, 0, sizeof *lazy);
+    lazy->arena = arena;
+
+    size_t pos = json_skip_ws(data, len, 0);
+    struct json_value* root = NULL;
+    if (pos < len && data[pos] == '{')
+        root = new_object(lazy);
+    if (root != NULL && index_members(data, len, pos, root, lazy))
+        return root;
+
+    json_lazy_release(lazy);
+    if (arena != NULL)
+        return &arena_error;
+    json_pool_release(root, false);
+    return json_pool_value(JSON_ERROR);
+}
+
+struct json_value* json_lazy_value(struct json_lazy* lazy, size_t i) {
+    struct json_parser parser;
+    json_parser_init(&parser);
+    parser.arena = lazy->arena;
+    parser.insitu = true;
+    json_parser_feed(&parser, lazy->ranges[i].data, lazy->ranges[i].len);
+    lazy->out_of_memory = lazy->out_of_memory || parser.out_of_memory;
+    return json_parser_finish(&parser);
+}
+
+void json_lazy_release(struct json_lazy* lazy) {
+    if (lazy->arena == NULL)
+        json_pool_free(lazy->ranges, lazy->capacity * sizeof *lazy->ranges);
+    lazy->ranges = NULL;
+    lazy->size = 0;
+    lazy->capacity = 0;
+}
@@ -0,0 +1,52 @@
+#ifndef JSON_LAZY_H_
+#define JSON_LAZY_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Lazy parsing of a request body. Only the top level object is parsed up
+ * front: its keys are borrowed from the input like in parse_json_insitu(),
+ * and its member values are left NULL and kept as byte ranges. A value is
+ * parsed when it is first needed, so values nobody asks for are never
+ * parsed and never allocated. Indexing only matches brackets and skips
+ * strings; a malformed value is reported when it is parsed.
+ */
+
+struct json_value;
+struct json_arena;
+
+struct json_lazy_range {
+    char* data;
+    size_t len;
+};
+
+struct json_lazy {
+    // tree memory, as for parse_json_arena(), or the pools if NULL
+    struct json_arena* arena;
+    // value bytes of the members of the root, in order
+    struct json_lazy_range* ranges;
+    size_t size;
+    size_t capacity;
+    // a value could not be parsed for lack of memory
+    bool out_of_memory;
+};
+
+// Indexes the object in data, which is modified and has to outlive the
+// tree. Returns the object with NULL member values, or a JSON_ERROR value
+// if data does not hold an object or memory ran out (lazy->out_of_memory).
+struct json_value* parse_json_lazy(char* data, const size_t len, struct json_arena* arena,
+                                   struct json_lazy* lazy);
+// Parses the value of the i-th member. The caller stores it in the tree,
+// which is then released like one from parse_json_insitu(), or with the
+// arena. Returns a JSON_ERROR value if the value is malformed.
+struct json_value* json_lazy_value(struct json_lazy* lazy, size_t i);
+// Releases the ranges, not the tree
+void json_lazy_release(struct json_lazy* lazy);
+
+// Position after the value starting at pos, or 0 if it does not end before
+// len. Containers end at their matching bracket, scalars at the next
+// delimiter. The value is not validated.
+size_t json_skip_value(const char* data, size_t len, size_t pos);
+
+#endif
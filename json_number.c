@@ -0,0 +1,599 @@
+#include "json_number.h"
+#include "json_chars.h"
+#include <string.h>
+
+size_t json_number_span(const char* data, size_t len) {
+    size_t pos = 0;
+    while (pos < len && (json_char_class[(unsigned char) data[pos]] & JSON_CHAR_NUMBER)) {
+        pos++;
+    }
+    return pos;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// SWAR: checks and converts eight ASCII digits loaded as one word
+static inline bool is_eight_digits(uint64_t val) {
+    return (((val & 0xf0f0f0f0f0f0f0f0) | (((val + 0x0606060606060606) & 0xf0f0f0f0f0f0f0f0) >> 4))
+            == 0x3333333333333333);
+}
+
+static inline uint32_t parse_eight_digits(uint64_t val) {
+    const uint64_t mask = 0x000000ff000000ff;
+    const uint64_t mul1 = 0x000f424000000064; // 100 + (1000000 << 32)
+    const uint64_t mul2 = 0x0000271000000001; // 1 + (10000 << 32)
+    val -= 0x3030303030303030;
+    val = (val * 10) + (val >> 8);
+    val = (((val & mask) * mul1) + (((val >> 16) & mask) * mul2)) >> 32;
+    return val;
+}
+#endif
+
+// Accumulates the digits at p into *mantissa, which wraps after 19 digits.
+// The callers count digits to know when that happened.
+static const char* parse_digits(const char* p, const char* end, uint64_t* mantissa) {
+    uint64_t num = *mantissa;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (end - p >= 8) {
+        uint64_t val;
+        memcpy(&val, p, sizeof val);
+        if (!is_eight_digits(val))
+            break;
+        num = num * 100000000 + parse_eight_digits(val);
+        p += 8;
+    }
+#endif
+    for (; p < end && json_is_digit(*p); p++) {
+        num = num * 10 + (*p - '0');
+    }
+    *mantissa = num;
+    return p;
+}
+
+static inline uint64_t mul_128(uint64_t a, uint64_t b, uint64_t* hi) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = (unsigned __int128) a * b;
+    *hi = r >> 64;
+    return (uint64_t) r;
+#else
+    uint64_t a_lo = (uint32_t) a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t) b, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    uint64_t hi_hi = a_hi * b_hi;
+    uint64_t cross = (lo_lo >> 32) + (uint32_t) hi_lo + lo_hi;
+    *hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    return (cross << 32) | (uint32_t) lo_lo;
+#endif
+}
+
+static inline double double_from_bits(uint64_t bits) {
+    double d;
+    memcpy(&d, &bits, sizeof d);
+    return d;
+}
+
+// Eisel-Lemire: computes mantissa * 10^exp10 correctly rounded, or returns
+// false in the rare cases it cannot decide.
+static bool eisel_lemire(uint64_t mantissa, int exp10, bool negative, double* out) {
+    if (mantissa == 0 || exp10 < JSON_POW10_MIN) {
+        *out = negative ? -0.0 : 0.0;
+        return true;
+    }
+    if (exp10 > JSON_POW10_MAX)
+        return false;
+
+    // normalization
+    int clz = __builtin_clzll(mantissa);
+    mantissa <<= clz;
+    uint64_t ret_exp2 = (uint64_t) (((217706 * exp10) >> 16) + 64 + 1023) - clz;
+
+    // multiplication
+    const uint64_t* pow10 = json_pow10_128[exp10 - JSON_POW10_MIN];
+    uint64_t x_hi;
+    uint64_t x_lo = mul_128(mantissa, pow10[0], &x_hi);
+
+    // wider approximation
+    if ((x_hi & 0x1ff) == 0x1ff && x_lo + mantissa < mantissa) {
+        uint64_t y_hi;
+        uint64_t y_lo = mul_128(mantissa, pow10[1], &y_hi);
+        uint64_t merged_hi = x_hi, merged_lo = x_lo + y_hi;
+        if (merged_lo < x_lo)
+            merged_hi++;
+        if ((merged_hi & 0x1ff) == 0x1ff && merged_lo + 1 == 0 && y_lo + mantissa < mantissa)
+            return false;
+        x_hi = merged_hi;
+        x_lo = merged_lo;
+    }
+
+    // shifting to 54 bits
+    uint64_t msb = x_hi >> 63;
+    uint64_t ret_mantissa = x_hi >> (msb + 9);
+    ret_exp2 -= 1 ^ msb;
+
+    // half-way ambiguity
+    if (x_lo == 0 && (x_hi & 0x1ff) == 0 && (ret_mantissa & 3) == 1)
+        return false;
+
+    // from 54 to 53 bits
+    ret_mantissa += ret_mantissa & 1;
+    ret_mantissa >>= 1;
+    if (ret_mantissa >> 53 > 0) {
+        ret_mantissa >>= 1;
+        ret_exp2 += 1;
+    }
+    // subnormals, infinity and NaN are left to the slow path
+    if (ret_exp2 - 1 >= 0x7ff - 1)
+        return false;
+    uint64_t bits = ret_exp2 << 52 | (ret_mantissa & 0x000fffffffffffff);
+    if (negative)
+        bits |= UINT64_C(1) << 63;
+    *out = double_from_bits(bits);
+    return true;
+}
+
+/*
+ * Slow path: exact decimal to binary conversion by shifting a big decimal,
+ * as done by the Go standard library (strconv/decimal.go).
+ */
+#define DECIMAL_DIGITS 800
+#define DECIMAL_MAX_SHIFT 60
+
+struct decimal {
+    uint8_t d[DECIMAL_DIGITS]; // digits, most significant first
+    int nd;                    // number of digits used
+    int dp;                    // decimal point
+    bool trunc;                // discarded nonzero digits beyond d[:nd]
+};
+
+static void decimal_trim(struct decimal* a) {
+    while (a->nd > 0 && a->d[a->nd - 1] == '0') {
+        a->nd--;
+    }
+    if (a->nd == 0)
+        a->dp = 0;
+}
+
+static void decimal_right_shift(struct decimal* a, unsigned k) {
+    int r = 0; // read pointer
+    int w = 0; // write pointer
+
+    // pick up enough leading digits to cover first shift
+    uint64_t n = 0;
+    for (; n >> k == 0; r++) {
+        if (r >= a->nd) {
+            if (n == 0) {
+                a->nd = 0;
+                return;
+            }
+            while (n >> k == 0) {
+                n = n * 10;
+                r++;
+            }
+            break;
+        }
+        n = n * 10 + a->d[r] - '0';
+    }
+    a->dp -= r - 1;
+
+    uint64_t mask = (UINT64_C(1) << k) - 1;
+    // pick up a digit, put down a digit
+    for (; r < a->nd; r++) {
+        uint64_t c = a->d[r];
+        uint64_t dig = n >> k;
+        n &= mask;
+        a->d[w++] = dig + '0';
+        n = n * 10 + c - '0';
+    }
+    // put down extra digits
+    while (n > 0) {
+        uint64_t dig = n >> k;
+        n &= mask;
+        if (w < DECIMAL_DIGITS)
+            a->d[w++] = dig + '0';
+        else if (dig > 0)
+            a->trunc = true;
+        n = n * 10;
+    }
+    a->nd = w;
+    decimal_trim(a);
+}
+
+// Number of new digits a left shift by k introduces and the digits of 5^k:
+// one digit less if the decimal is below that prefix
+static const struct {
+    int delta;
+    const char* cutoff;
+} left_cheats[DECIMAL_MAX_SHIFT + 1] = {
+    {0, ""},
+    {1, "5"},
+    {1, "25"},
+    {1, "125"},
+    {2, "625"},
+    {2, "3125"},
+    {2, "15625"},
+    {3, "78125"},
+    {3, "390625"},
+    {3, "1953125"},
+    {4, "9765625"},
+    {4, "48828125"},
+    {4, "244140625"},
+    {4, "1220703125"},
+    {5, "6103515625"},
+    {5, "30517578125"},
+    {5, "152587890625"},
+    {6, "762939453125"},
+    {6, "3814697265625"},
+    {6, "19073486328125"},
+    {7, "95367431640625"},
+    {7, "476837158203125"},
+    {7, "2384185791015625"},
+    {7, "11920928955078125"},
+    {8, "59604644775390625"},
+    {8, "298023223876953125"},
+    {8, "1490116119384765625"},
+    {9, "7450580596923828125"},
+    {9, "37252902984619140625"},
+    {9, "186264514923095703125"},
+    {10, "931322574615478515625"},
+    {10, "4656612873077392578125"},
+    {10, "23283064365386962890625"},
+    {10, "116415321826934814453125"},
+    {11, "582076609134674072265625"},
+    {11, "2910383045673370361328125"},
+    {11, "14551915228366851806640625"},
+    {12, "72759576141834259033203125"},
+    {12, "363797880709171295166015625"},
+    {12, "1818989403545856475830078125"},
+    {13, "9094947017729282379150390625"},
+    {13, "45474735088646411895751953125"},
+    {13, "227373675443232059478759765625"},
+    {13, "1136868377216160297393798828125"},
+    {14, "5684341886080801486968994140625"},
+    {14, "28421709430404007434844970703125"},
+    {14, "142108547152020037174224853515625"},
+    {15, "710542735760100185871124267578125"},
+    {15, "3552713678800500929355621337890625"},
+    {15, "17763568394002504646778106689453125"},
+    {16, "88817841970012523233890533447265625"},
+    {16, "444089209850062616169452667236328125"},
+    {16, "2220446049250313080847263336181640625"},
+    {16, "11102230246251565404236316680908203125"},
+    {17, "55511151231257827021181583404541015625"},
+    {17, "277555756156289135105907917022705078125"},
+    {17, "1387778780781445675529539585113525390625"},
+    {18, "6938893903907228377647697925567626953125"},
+    {18, "34694469519536141888238489627838134765625"},
+    {18, "173472347597680709441192448139190673828125"},
+    {19, "867361737988403547205962240695953369140625"},
+};
+
+static bool prefix_is_less_than(const uint8_t* b, int nd, const char* s) {
+    for (int i = 0; s[i] != '\0'; i++) {
+        if (i >= nd)
+            return true;
+        if (b[i] != (uint8_t) s[i])
+            return b[i] < (uint8_t) s[i];
+    }
+    return false;
+}
+
+static void decimal_left_shift(struct decimal* a, unsigned k) {
+    int delta = left_cheats[k].delta;
+    if (prefix_is_less_than(a->d, a->nd, left_cheats[k].cutoff))
+        delta--;
+
+    int r = a->nd;         // read index
+    int w = a->nd + delta; // write index
+    uint64_t n = 0;
+    // pick up a digit, put down a digit
+    for (r--; r >= 0; r--) {
+        n += (uint64_t) (a->d[r] - '0') << k;
+        uint64_t quo = n / 10;
+        uint64_t rem = n - 10 * quo;
+        w--;
+        if (w < DECIMAL_DIGITS)
+            a->d[w] = rem + '0';
+        else if (rem != 0)
+            a->trunc = true;
+        n = quo;
+    }
+    // put down extra digits
+    while (n > 0) {
+        uint64_t quo = n / 10;
+        uint64_t rem = n - 10 * quo;
+        w--;
+        if (w < DECIMAL_DIGITS)
+            a->d[w] = rem + '0';
+        else if (rem != 0)
+            a->trunc = true;
+        n = quo;
+    }
+    a->nd += delta;
+    if (a->nd >= DECIMAL_DIGITS)
+        a->nd = DECIMAL_DIGITS;
+    a->dp += delta;
+    decimal_trim(a);
+}
+
+static void decimal_shift(struct decimal* a, int k) {
+    if (a->nd == 0)
+        return;
+    if (k > 0) {
+        for (; k > DECIMAL_MAX_SHIFT; k -= DECIMAL_MAX_SHIFT)
+            decimal_left_shift(a, DECIMAL_MAX_SHIFT);
+        decimal_left_shift(a, k);
+    } else if (k < 0) {
+        for (; k < -DECIMAL_MAX_SHIFT; k += DECIMAL_MAX_SHIFT)
+            decimal_right_shift(a, DECIMAL_MAX_SHIFT);
+        decimal_right_shift(a, -k);
+    }
+}
+
+static bool decimal_should_round_up(const struct decimal* a, int nd) {
+    if (nd < 0 || nd >= a->nd)
+        return false;
+    if (a->d[nd] == '5' && nd + 1 == a->nd) {
+        // exactly halfway, round to even unless digits were truncated
+        if (a->trunc)
+            return true;
+        return nd > 0 && (a->d[nd - 1] - '0') % 2 == 1;
+    }
+    return a->d[nd] >= '5';
+}
+
+static uint64_t decimal_rounded_integer(const struct decimal* a) {
+    if (a->dp > 20)
+        return UINT64_MAX;
+    int i;
+    uint64_t n = 0;
+    for (i = 0; i < a->dp && i < a->nd; i++)
+        n = n * 10 + (a->d[i] - '0');
+    for (; i < a->dp; i++)
+        n *= 10;
+    if (decimal_should_round_up(a, a->dp))
+        n++;
+    return n;
+}
+
+// Converts the decimal to a double, returns false on overflow
+static bool decimal_to_double(struct decimal* d, bool negative, double* out) {
+    static const int powtab[] = {1, 3, 6, 9, 13, 16, 19, 23, 26};
+    const int mantbits = 52, expbits = 11, bias = -1023;
+    int exp = 0;
+    uint64_t mant = 0;
+
+    if (d->nd == 0 || d->dp < -330) {
+        exp = bias;
+        goto out;
+    }
+    if (d->dp > 310)
+        return false;
+
+    // scale by powers of two until in range [0.5, 1.0)
+    while (d->dp > 0) {
+        int n = d->dp >= 9 ? 27 : powtab[d->dp];
+        decimal_shift(d, -n);
+        exp += n;
+    }
+    while (d->dp < 0 || (d->dp == 0 && d->d[0] < '5')) {
+        int n = -d->dp >= 9 ? 27 : powtab[-d->dp];
+        decimal_shift(d, n);
+        exp -= n;
+    }
+    // our range is [0.5, 1) but floating point range is [1, 2)
+    exp--;
+    // minimum representable exponent is bias + 1
+    if (exp < bias + 1) {
+        int n = bias + 1 - exp;
+        decimal_shift(d, -n);
+        exp += n;
+    }
+    if (exp - bias >= (1 << expbits) - 1)
+        return false;
+
+    // extract 1 + mantbits bits
+    decimal_shift(d, 1 + mantbits);
+    mant = decimal_rounded_integer(d);
+    // rounding might have added a bit, shift down
+    if (mant == UINT64_C(2) << mantbits) {
+        mant >>= 1;
+        exp++;
+        if (exp - bias >= (1 << expbits) - 1)
+            return false;
+    }
+    // denormalized?
+    if ((mant & (UINT64_C(1) << mantbits)) == 0)
+        exp = bias;
+
+out:;
+    uint64_t bits = mant & ((UINT64_C(1) << mantbits) - 1);
+    bits |= (uint64_t) ((exp - bias) & ((1 << expbits) - 1)) << mantbits;
+    if (negative)
+        bits |= UINT64_C(1) << 63;
+    *out = double_from_bits(bits);
+    return true;
+}
+
+static const double exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/*
+ * Converts the digits in [start, end) (the integer and fraction parts, the
+ * '.' is skipped) times 10^exp10 to a double.
+ */
+static bool digits_to_double(const char* start, const char* end, int int_digits,
+                             int64_t exp10, bool negative, double* out) {
+    // skip leading zeros, value = 0.D * 10^dp for the significant digits D
+    const char* p = start;
+    int skipped = 0;
+    for (; p < end && (*p == '0' || *p == '.'); p++) {
+        if (*p == '0')
+            skipped++;
+    }
+    if (p == end) {
+        *out = negative ? -0.0 : 0.0;
+        return true;
+    }
+    // the exponent was clamped while parsing, so this cannot overflow
+    int64_t dp = int_digits - skipped + exp10;
+
+    // the first 19 significant digits, and whether any dropped one is nonzero
+    uint64_t mantissa = 0;
+    int digits = 0;
+    bool trunc = false;
+    const char* q = p;
+    for (; q < end; q++) {
+        if (*q == '.')
+            continue;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*q - '0');
+            digits++;
+        } else if (*q != '0') {
+            trunc = true;
+        }
+    }
+    int64_t exp = dp - digits;
+
+    if (dp > 310) {
+        return false;
+    }
+    if (dp < -330) {
+        *out = negative ? -0.0 : 0.0;
+        return true;
+    }
+
+    // Clinger's fast path: both operands are exact doubles
+    if (!trunc && mantissa <= (UINT64_C(1) << 53) && exp >= -22 && exp <= 22) {
+        double d = (double) mantissa;
+        d = exp < 0 ? d / exact_pow10[-exp] : d * exact_pow10[exp];
+        *out = negative ? -d : d;
+        return true;
+    }
+
+    // Eisel-Lemire, on truncated input it has to agree for both neighbours
+    double d;
+    if (eisel_lemire(mantissa, exp, negative, &d)) {
+        double up;
+        if (!trunc || (eisel_lemire(mantissa + 1, exp, negative, &up) && up == d)) {
+            *out = d;
+            return true;
+        }
+    }
+
+    struct decimal decimal;
+    struct decimal* a = &decimal;
+    a->nd = 0;
+    a->trunc = false;
+    a->dp = dp;
+    for (q = p; q < end; q++) {
+        if (*q == '.')
+            continue;
+        if (a->nd < DECIMAL_DIGITS)
+            a->d[a->nd++] = *q;
+        else if (*q != '0')
+            a->trunc = true;
+    }
+    decimal_trim(a);
+    return decimal_to_double(a, negative, out);
+}
+
+size_t json_parse_number(const char* data, size_t len, struct json_number* number) {
+    const char* p = data;
+    const char* end = data + len;
+    bool negative = p < end && *p == '-';
+    if (negative)
+        p++;
+    if (p == end || !json_is_digit(*p))
+        return 0;
+
+    // integer part, no leading zeros allowed
+    const char* start = p;
+    uint64_t mantissa = 0;
+    if (*p == '0')
+        p++;
+    else
+        p = parse_digits(p, end, &mantissa);
+    int int_digits = p - start;
+
+    bool is_integer = true;
+    if (p < end && *p == '.') {
+        is_integer = false;
+        const char* fraction = ++p;
+        p = parse_digits(p, end, &mantissa);
+        if (p == fraction)
+            return 0;
+    }
+    const char* digits_end = p;
+
+    int64_t exp10 = 0;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        is_integer = false;
+        p++;
+        bool exp_negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+'))
+            p++;
+        if (p == end || !json_is_digit(*p))
+            return 0;
+        for (; p < end && json_is_digit(*p); p++) {
+            // anything beyond this is zero or infinity anyway
+            if (exp10 < 100000)
+                exp10 = exp10 * 10 + (*p - '0');
+        }
+        if (exp_negative)
+            exp10 = -exp10;
+    }
+
+    if (is_integer && int_digits <= 20) {
+        bool fits = int_digits < 20;
+        if (!fits) {
+            // 20 digits overflow above UINT64_MAX, recompute checked
+            uint64_t num = 0;
+            fits = true;
+            for (const char* q = start; q < digits_end && fits; q++) {
+                fits = !__builtin_mul_overflow(num, 10, &num)
+                    && !__builtin_add_overflow(num, (uint64_t) (*q - '0'), &num);
+            }
+            mantissa = num;
+        }
+        if (fits && negative && mantissa <= (UINT64_C(1) << 63)) {
+            number->type = JSON_NUMBER_INT;
+            number->integer = (int64_t) (0 - mantissa);
+            return p - data;
+        }
+        if (fits && !negative) {
+            if (mantissa <= INT64_MAX) {
+                number->type = JSON_NUMBER_INT;
+                number->integer = mantissa;
+            } else {
+                number->type = JSON_NUMBER_UINT;
+                number->uinteger = mantissa;
+            }
+            return p - data;
+        }
+    }
+
+    number->type = JSON_NUMBER_DOUBLE;
+    if (!digits_to_double(start, digits_end, int_digits, exp10, negative, &number->real))
+        return 0;
+    return p - data;
+}
+
+bool json_number_to_int(const struct json_number* number, int64_t* integer) {
+    switch (number->type) {
+        case JSON_NUMBER_INT:
+            *integer = number->integer;
+            return true;
+        case JSON_NUMBER_UINT:
+            return false;
+        case JSON_NUMBER_DOUBLE:
+            // 2^63 is exact as a double, INT64_MAX is not
+            if (!(number->real >= -9223372036854775808.0 && number->real < 9223372036854775808.0))
+                return false;
+            *integer = (int64_t) number->real;
+            return (double) *integer == number->real;
+    }
+    return false;
+}
@@ -0,0 +1,48 @@
+#ifndef JSON_NUMBER_H_
+#define JSON_NUMBER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Longest number the push parser buffers when it is split across chunks
+#define JSON_NUMBER_MAX 64
+
+enum json_number_type {
+    // integer syntax within int64_t
+    JSON_NUMBER_INT,
+    // integer syntax above INT64_MAX but within uint64_t
+    JSON_NUMBER_UINT,
+    // a fraction or exponent, or an integer too large for 64 bits
+    JSON_NUMBER_DOUBLE,
+};
+
+struct json_number {
+    enum json_number_type type;
+    union {
+        int64_t integer;
+        uint64_t uinteger;
+        double real;
+    };
+};
+
+// Length of the leading run of data made of characters that can appear in
+// a number. The number itself is validated by json_parse_number().
+size_t json_number_span(const char* data, size_t len);
+
+// Parses the number at the start of data following the RFC 8259 grammar.
+// Doubles are correctly rounded. Returns the number of bytes consumed, or 0
+// if data does not start with a number or the number is outside the range
+// of a double.
+size_t json_parse_number(const char* data, size_t len, struct json_number* number);
+
+// Converts a parsed number to the int64_t the json_value tree can hold.
+// Doubles are accepted if they hold an integral value within range.
+bool json_number_to_int(const struct json_number* number, int64_t* integer);
+
+#define JSON_POW10_MIN (-342)
+#define JSON_POW10_MAX 308
+// see json_pow10.c
+extern const uint64_t json_pow10_128[JSON_POW10_MAX - JSON_POW10_MIN + 1][2];
+
+#endif
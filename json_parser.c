@@ -1,246 +1,192 @@
 #include "json_parser.h"
+#include "json_string.h"
+#include "json_number.h"
+#include "json_chars.h"
+#include "json_pool.h"
+#include "json_arena.h"
+#include "json_intern.h"
 #include <uk/json_ir.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <string.h>
-#include <stdbool.h>
 
-struct json_parser_state {
-    const char* data;
-    size_t len;
-    size_t pos;
-    bool error;
-};
-
-static struct json_value* parse_value(struct json_parser_state* state);
-static char* parse_string(struct json_parser_state* state);
-
-static bool check_end(struct json_parser_state* state) {
-    state->error = state->pos >= state->len;
-    return !state->error;
-}
-
-static bool expect_char(struct json_parser_state* state, char check) {
-    if (!check_end(state))
-        return false;
-    state->error = state->data[state->pos] != check;
-    if (!state->error)
-        state->pos++;
-    return !state->error;
+static void out_of_memory(struct json_parser* parser) {
+    parser->error = true;
+    parser->out_of_memory = true;
 }
 
-static void parse_ws(struct json_parser_state* state) {
-    while (state->pos < state->len && isspace(state->data[state->pos])) {
-        state->pos++;
+// Nodes and strings come from the parser's arena if it has one and from
+// the pools otherwise. Running out of memory fails the parse.
+static struct json_value* new_value(struct json_parser* parser, enum json_type type) {
+    struct json_value* value;
+    if (parser->arena != NULL) {
+        value = json_arena_alloc(parser->arena, sizeof *value);
+        if (value != NULL)
+            value->type = type;
+    } else {
+        value = json_pool_value(type);
     }
+    if (value == NULL)
+        out_of_memory(parser);
+    return value;
 }
 
-static struct json_value* parse_element(struct json_parser_state* state) {
-    parse_ws(state);
-    struct json_value* value = parse_value(state);
-    if (state->error) {
-        free_json_value(value);
-        return NULL;
-    }
-    parse_ws(state);
-    return value;
+static void* resize(struct json_parser* parser, void* ptr, size_t old_size, size_t new_size) {
+    void* block;
+    if (parser->arena != NULL)
+        block = json_arena_realloc(parser->arena, ptr, old_size, new_size);
+    else
+        block = json_pool_realloc(ptr, old_size, new_size);
+    if (block == NULL)
+        out_of_memory(parser);
+    return block;
 }
 
-static struct json_object* parse_member(struct json_parser_state* state) {
-    parse_ws(state);
-    char* key = parse_string(state);
-    if (state->error) {
-        free(key);
-        return NULL;
-    }
-    parse_ws(state);
-    if (!expect_char(state, ':')) {
-        free(key);
-        return NULL;
+static void append_string(struct json_parser* parser, const char* data, size_t len) {
+    if (len == 0)
+        return;
+    size_t needed = parser->string_len + len + 1;
+    if (needed > parser->string_capacity) {
+        // The first run is allocated exactly, so a string that is not split
+        // by escapes or chunk boundaries costs a single allocation. Strings
+        // are released by their length, which stays in the size class of
+        // the last allocation.
+        size_t capacity = parser->string == NULL ? needed : 2 * parser->string_capacity;
+        if (capacity < needed)
+            capacity = needed;
+        // round up to the slab the string ends up in anyway
+        if (parser->arena == NULL)
+            capacity = json_pool_size(capacity);
+        char* string = resize(parser, parser->string, parser->string_capacity, capacity);
+        if (string == NULL)
+            return;
+        parser->string = string;
+        parser->string_capacity = capacity;
     }
-    struct json_value* value = parse_element(state);
-    if (state->error) {
-        free(key);
-        free_json_value(value);
-        return NULL;
-    }
-    struct json_object* object = malloc(sizeof(struct json_object));
-    object->key = key;
-    object->value = value;
-    object->next = NULL;
-    return object;
+    memcpy(&parser->string[parser->string_len], data, len);
+    parser->string_len += len;
 }
 
-static struct json_object* parse_object(struct json_parser_state* state) {
-    if (!expect_char(state, '{')) {
-        return NULL;
-    }
-    parse_ws(state);
-    if (!check_end(state))
-        return NULL;
-    if (state->data[state->pos] == '}') {
-        // This is an empty object
-        state->pos++; // }
-        return NULL;
-    }
-    // Otherwise, we have a head member
-    struct json_object* head = parse_member(state);
-    if (state->error) {
-        free_json_object(head);
-        return NULL;
-    }
-    struct json_object* curr = head;
-    while(state->data[state->pos] != '}') {
-        if (!expect_char(state, ',')) {
-            free_json_object(head);
-            return NULL;
-        }
-        // get the next member, and append to the list
-        curr->next = parse_member(state);
-        if (state->error) {
-            free_json_object(head);
+// Hands the accumulated string over to the caller
+static char* take_string(struct json_parser* parser) {
+    char* string = parser->string;
+    if (string == NULL) {
+        string = resize(parser, NULL, 0, 1);
+        if (string == NULL)
             return NULL;
-        }
-        curr = curr->next;
     }
-    if (!expect_char(state, '}')) {
-        free_json_object(head);
-        return NULL;
-    }
-    return head;
+    string[parser->string_len] = '\0';
+    parser->string = NULL;
+    parser->string_len = 0;
+    parser->string_capacity = 0;
+    return string;
 }
 
-static struct json_array* parse_array(struct json_parser_state* state) {
-    if (!expect_char(state, '[')) {
-        return NULL;
-    }
-    parse_ws(state);
-    if (!check_end(state))
-        return NULL;
-    
-    struct json_array* array = malloc(sizeof *array);
-    array->values = NULL;
-    array->size = 0;
-    if (state->data[state->pos] == ']') {
-        // This is an empty array
-        state->pos++; // }
-        return array;
-    }
-    // Otherwise, array is non-empty, initialize
-    size_t capacity = 16;
-    array->values = calloc(capacity, sizeof *array->values);
-    
-    // get the first element
-    array->values[0] = parse_element(state);
-    array->size = 1;
-    if (state->error) {
-        free_json_array(array);
-        return NULL;
-    }
-
-    while(state->data[state->pos] != ']') {
-        if (!expect_char(state, ',')) {
-            free_json_array(array);
-            return NULL;
-        }
-        // get the next element
-        struct json_value* next = parse_element(state);
-        if (state->error) {
-            free_json_value(next);
-            free_json_array(array);
-            return NULL;
-        }
-
-        // reallocate if we need more space
-        if (array->size == capacity) {
-            capacity *= 2;
-            struct json_value** new_values = calloc(capacity, sizeof *new_values);
-            memcpy(new_values, array->values, array->size * sizeof *array->values);
-            free(array->values);
-            array->values = new_values;
-        }
-        array->values[array->size] = next;
-        array->size++;
-    }
-    if (!expect_char(state, ']')) {
-        free_json_array(array);
-        return NULL;
-    }
-    return array;
+static void end_value(struct json_parser* parser) {
+    parser->token = TOKEN_NONE;
+    parser->value = NULL;
+    parser->step = parser->depth == 0 ? PARSE_DONE : PARSE_AFTER_VALUE;
 }
 
-static char* parse_string(struct json_parser_state* state) {
-    if (!expect_char(state, '"'))
-        return NULL;
-
-    // first count the chars
-    size_t start_pos = state->pos;
-    size_t count;
-    for (count = 0;
-         state->pos < state->len && state->data[state->pos] != '"';
-         state->pos++, count++) {
-        if (state->data[state->pos] == '\\') {
-            // skip escaped chars
-            state->pos++;
-        }
+static void attach_value(struct json_parser* parser, struct json_value* value) {
+    if (parser->depth == 0) {
+        parser->root = value;
+        return;
     }
 
-    if (!check_end(state)) {
-        return NULL;        
+    struct json_parser_frame* frame = &parser->stack[parser->depth - 1];
+    if (frame->container->type == JSON_OBJECT) {
+        frame->tail->value = value;
+        return;
     }
 
-    // rewind to the start of the string
-    state->pos = start_pos;
-
-    char* string = malloc(sizeof(char) * (count + 1));
-    for (size_t str_pos = 0;
-         state->data[state->pos] != '"';
-         state->pos++, str_pos++) {
-        if (state->data[state->pos] == '\\') {
-            // TODO: Add proper escape character handling
-            // Just skip backslashes for now
-            state->pos++;
+    // kept on the scratch stack until the array is closed
+    if (parser->scratch_len == parser->scratch_capacity) {
+        size_t capacity = 2 * parser->scratch_capacity;
+        struct json_value** scratch;
+        if (parser->scratch == parser->scratch_inline) {
+            scratch = resize(parser, NULL, 0, capacity * sizeof *scratch);
+            if (scratch != NULL)
+                memcpy(scratch, parser->scratch_inline, sizeof parser->scratch_inline);
+        } else {
+            scratch = resize(parser, parser->scratch, parser->scratch_capacity * sizeof *scratch,
+                             capacity * sizeof *scratch);
         }
-        string[str_pos] = state->data[state->pos];
+        if (scratch == NULL)
+            return;
+        parser->scratch = scratch;
+        parser->scratch_capacity = capacity;
     }
-    string[count] = '\0';
-    if (!expect_char(state, '"')) {
-        free(string);
-        return NULL;
+    parser->scratch[parser->scratch_len++] = value;
+}
+
+static void push_container(struct json_parser* parser, struct json_value* container) {
+    if (parser->depth == JSON_MAX_DEPTH) {
+        parser->error = true;
+        return;
     }
-    return string;
+    struct json_parser_frame* frame = &parser->stack[parser->depth++];
+    frame->container = container;
+    frame->tail = NULL;
+    frame->start = parser->scratch_len;
+    parser->step = container->type == JSON_OBJECT ? PARSE_FIRST_MEMBER : PARSE_FIRST_VALUE;
 }
 
-static int64_t parse_int(struct json_parser_state* state) {
-    // TODO: Use stdlib to parse this?
-    if (!check_end(state))
-        return 0;
-    bool negative = state->data[state->pos] == '-';
-    if (negative)
-        state->pos++; // -
-
-    if (!check_end(state))
-        return 0;
-    if (!isdigit(state->data[state->pos])) {
-        state->error = true;
-        return 0;
+static void pop_container(struct json_parser* parser) {
+    struct json_parser_frame* frame = &parser->stack[parser->depth - 1];
+    if (frame->container->type == JSON_ARRAY && parser->scratch_len > frame->start) {
+        // move the elements into a block of exactly their number
+        size_t size = parser->scratch_len - frame->start;
+        struct json_value** values = resize(parser, NULL, 0, size * sizeof *values);
+        if (values == NULL)
+            return;
+        memcpy(values, &parser->scratch[frame->start], size * sizeof *values);
+        frame->container->array->values = values;
+        frame->container->array->size = size;
+        parser->scratch_len = frame->start;
     }
+    parser->depth--;
+    end_value(parser);
+}
 
-    int64_t num = 0;
-    for (; state->pos < state->len && isdigit(state->data[state->pos]); state->pos++) {
-        num *= 10;
-        num += state->data[state->pos] - '0';
+static void add_member(struct json_parser* parser, char* key) {
+    struct json_parser_frame* frame = &parser->stack[parser->depth - 1];
+    struct json_object* object;
+    if (parser->arena != NULL)
+        object = json_arena_alloc(parser->arena, sizeof *object);
+    else
+        object = json_pool_object();
+    if (object == NULL) {
+        if (!parser->insitu && parser->arena == NULL && !json_intern_owns(key))
+            json_pool_free(key, strlen(key) + 1);
+        out_of_memory(parser);
+        return;
     }
-    if (negative)
-        num *= -1;
-    return num;
+    object->key = key;
+    object->value = NULL;
+    object->next = NULL;
+    if (frame->tail == NULL)
+        frame->container->object = object;
+    else
+        frame->tail->next = object;
+    frame->tail = object;
 }
 
-static struct json_value* parse_value(struct json_parser_state* state) {
-    if (!check_end(state))
-        return NULL;
-    struct json_value* value = create_json_value(JSON_ERROR);
-    char next_char = state->data[state->pos];
+// Creates the value starting with data[pos] and attaches it to the tree.
+// Scalars are completed by the token they start, literals right away if
+// they are not split by the end of the chunk.
+static size_t parse_value(struct json_parser* parser, const char* data, size_t len, size_t pos) {
+    struct json_value* value = new_value(parser, JSON_ERROR);
+    if (value == NULL)
+        return pos;
+    attach_value(parser, value);
+    if (parser->error) {
+        // not attached, so not released with the tree
+        if (parser->arena == NULL)
+            json_pool_release(value, false);
+        return pos;
+    }
+
+    char next_char = data[pos];
     // object: '{'
     // array: '['
     // string: '"'
@@ -251,53 +197,384 @@ static struct json_value* parse_value(struct json_parser_state* state) {
     switch (next_char) {
         case '{':
             value->type = JSON_OBJECT;
-            value->object = parse_object(state);
-            break;
+            value->object = NULL;
+            push_container(parser, value);
+            return pos + 1;
         case '[':
             value->type = JSON_ARRAY;
-            value->array = parse_array(state);
-            break;
+            value->array = parser->arena != NULL ? json_arena_alloc(parser->arena, sizeof *value->array)
+                                                 : json_pool_array();
+            if (value->array == NULL) {
+                // released as an empty object
+                value->type = JSON_OBJECT;
+                value->object = NULL;
+                out_of_memory(parser);
+                return pos;
+            }
+            value->array->values = NULL;
+            value->array->size = 0;
+            push_container(parser, value);
+            return pos + 1;
         case '"':
             value->type = JSON_STRING;
-            value->string = parse_string(state);
+            value->string = NULL;
+            parser->token = TOKEN_STRING;
             break;
         case 't':
             value->type = JSON_TRUE;
-            state->pos += 4;
+            parser->token = TOKEN_LITERAL;
+            parser->literal = "rue";
             break;
         case 'f':
             value->type = JSON_FALSE;
-            state->pos += 5;
+            parser->token = TOKEN_LITERAL;
+            parser->literal = "alse";
             break;
         case 'n':
             value->type = JSON_NULL;
-            state->pos += 4;
+            parser->token = TOKEN_LITERAL;
+            parser->literal = "ull";
             break;
         default:
             value->type = JSON_INT;
-            value->integer = parse_int(state);
+            value->integer = 0;
+            parser->token = TOKEN_NUMBER;
+            parser->number_len = 0;
+            // the first character is consumed by the token
+            parser->value = value;
+            return pos;
     }
-    
-    if (state->error) {
-        free_json_value(value);
-        return NULL;
+    parser->value = value;
+    size_t literal_len = json_literal_len(next_char);
+    if (parser->token == TOKEN_LITERAL && len - pos >= literal_len) {
+        // the whole literal is in this chunk, check it at once
+        if (!json_literal_matches(&data[pos])) {
+            parser->error = true;
+            return pos;
+        }
+        end_value(parser);
+        return pos + literal_len;
     }
-    return value;
+    return pos + 1;
 }
 
-struct json_value* parse_json(const char* data, const size_t len) {
-    struct json_parser_state state = {
-        .data = data,
-        .len = len,
-        .pos = 0,
-        .error = false,
-    };
-    struct json_value* result = parse_value(&state);
-
-    if (!state.error)
+static void end_string(struct json_parser* parser, char* string) {
+    if (parser->token == TOKEN_KEY) {
+        add_member(parser, string);
+        parser->token = TOKEN_NONE;
+        parser->step = PARSE_COLON;
+    } else {
+        parser->value->string = string;
+        end_value(parser);
+    }
+}
+
+// Appends the decoded escape sequence, the tree holds '\0' terminated
+// strings so an escaped NUL cannot be represented
+static void append_escape(struct json_parser* parser, const char* out, int count) {
+    if (count < 0 || (count == 1 && out[0] == '\0')) {
+        parser->error = true;
+        return;
+    }
+    append_string(parser, out, count);
+}
+
+static void end_copied_string(struct json_parser* parser) {
+    if (parser->string != NULL && !json_utf8_valid(parser->string, parser->string_len)) {
+        parser->error = true;
+        return;
+    }
+    char* string = take_string(parser);
+    if (string != NULL)
+        end_string(parser, string);
+}
+
+// Continues an escape sequence that was split by a chunk boundary
+static size_t parse_split_escape(struct json_parser* parser, const char* data, size_t len, size_t pos) {
+    while (pos < len) {
+        parser->escape_buf[parser->escape_len++] = data[pos++];
+        char out[4];
+        size_t used;
+        int count = json_decode_escape(parser->escape_buf, parser->escape_len, &used, out);
+        if (count != 0) {
+            parser->escape = false;
+            parser->escape_len = 0;
+            append_escape(parser, out, count);
+            break;
+        }
+    }
+    return pos;
+}
+
+static size_t parse_string(struct json_parser* parser, const char* data, size_t len, size_t pos) {
+    while (pos < len && !parser->error) {
+        if (parser->escape) {
+            pos = parse_split_escape(parser, data, len, pos);
+            continue;
+        }
+        // plain runs are copied as a block
+        size_t run = json_string_run(&data[pos], len - pos);
+        // a key in one plain run is looked up first, keys seen before
+        // need no copy
+        if (parser->token == TOKEN_KEY && parser->string_len == 0 && pos + run < len
+            && data[pos + run] == '"' && json_utf8_valid(&data[pos], run)) {
+            const char* key = json_intern(&data[pos], run);
+            if (key != NULL) {
+                end_string(parser, (char*) key);
+                return pos + run + 1;
+            }
+        }
+        append_string(parser, &data[pos], run);
+        pos += run;
+        if (pos == len)
+            break;
+        if (data[pos] == '"') {
+            pos++; // "
+            end_copied_string(parser);
+            break;
+        }
+        if (data[pos] != '\\') {
+            // unescaped control character
+            parser->error = true;
+            break;
+        }
+        pos++; // backslash
+        char out[4];
+        size_t used;
+        int count = json_decode_escape(&data[pos], len - pos, &used, out);
+        if (count == 0) {
+            // the sequence continues in the next chunk
+            parser->escape = true;
+            parser->escape_len = len - pos;
+            memcpy(parser->escape_buf, &data[pos], parser->escape_len);
+            pos = len;
+            break;
+        }
+        append_escape(parser, out, count);
+        pos += used;
+    }
+    return pos;
+}
+
+// Borrows the string from the input, see json_string_insitu(). An in situ
+// document is fed in one piece, so the string has to end in it.
+static size_t parse_string_insitu(struct json_parser* parser, char* data, size_t len, size_t pos) {
+    size_t end = json_string_insitu(data, len, pos);
+    if (end == 0) {
+        parser->error = true;
+        return pos;
+    }
+    end_string(parser, &data[pos]);
+    return end;
+}
+
+// The tree only holds integers, other numbers are rejected rather than
+// silently truncated
+static void end_number(struct json_parser* parser, const char* data, size_t len) {
+    struct json_number number;
+    int64_t integer;
+    if (len == 0 || json_parse_number(data, len, &number) != len || !json_number_to_int(&number, &integer)) {
+        parser->error = true;
+        return;
+    }
+    parser->value->integer = integer;
+    end_value(parser);
+}
+
+static size_t parse_number(struct json_parser* parser, const char* data, size_t len, size_t pos) {
+    size_t span = json_number_span(&data[pos], len - pos);
+    bool split = parser->number_len > 0 || pos + span == len;
+    if (split) {
+        if (parser->number_len + span > JSON_NUMBER_MAX) {
+            parser->error = true;
+            return pos;
+        }
+        memcpy(&parser->number[parser->number_len], &data[pos], span);
+        parser->number_len += span;
+    }
+    pos += span;
+    // the number ends at the first other character, which may be in the
+    // next chunk
+    if (pos == len)
+        return pos;
+    if (split)
+        end_number(parser, parser->number, parser->number_len);
+    else
+        end_number(parser, &data[pos - span], span);
+    return pos;
+}
+
+static size_t parse_literal(struct json_parser* parser, const char* data, size_t len, size_t pos) {
+    for (; pos < len && *parser->literal != '\0'; pos++, parser->literal++) {
+        if (data[pos] != *parser->literal) {
+            parser->error = true;
+            return pos;
+        }
+    }
+    if (*parser->literal == '\0')
+        end_value(parser);
+    return pos;
+}
+
+static size_t parse_token(struct json_parser* parser, const char* data, size_t len, size_t pos) {
+    switch (parser->token) {
+        case TOKEN_KEY:
+        case TOKEN_STRING:
+            if (parser->insitu)
+                return parse_string_insitu(parser, (char*) data, len, pos);
+            return parse_string(parser, data, len, pos);
+        case TOKEN_NUMBER:
+            return parse_number(parser, data, len, pos);
+        case TOKEN_LITERAL:
+            return parse_literal(parser, data, len, pos);
+        case TOKEN_NONE:
+            break;
+    }
+    return pos;
+}
+
+void json_parser_init(struct json_parser* parser) {
+    memset(parser, 0, offsetof(struct json_parser, stack));
+    parser->step = PARSE_VALUE;
+    parser->token = TOKEN_NONE;
+    parser->scratch = parser->scratch_inline;
+    parser->scratch_capacity = JSON_PARSER_SCRATCH;
+}
+
+bool json_parser_feed(struct json_parser* parser, const char* data, size_t len) {
+    size_t pos = 0;
+    while (pos < len && !parser->error) {
+        if (parser->token != TOKEN_NONE) {
+            pos = parse_token(parser, data, len, pos);
+            continue;
+        }
+        pos = json_skip_ws(data, len, pos);
+        if (pos == len)
+            break;
+
+        char next_char = data[pos];
+        bool in_object = parser->depth > 0
+            && parser->stack[parser->depth - 1].container->type == JSON_OBJECT;
+        switch (parser->step) {
+            case PARSE_FIRST_VALUE:
+                if (next_char == ']') {
+                    // This is an empty array
+                    pos++;
+                    pop_container(parser);
+                    break;
+                }
+                // fall through
+            case PARSE_VALUE:
+                pos = parse_value(parser, data, len, pos);
+                break;
+            case PARSE_FIRST_MEMBER:
+                if (next_char == '}') {
+                    // This is an empty object
+                    pos++;
+                    pop_container(parser);
+                    break;
+                }
+                // fall through
+            case PARSE_MEMBER:
+                parser->error = next_char != '"'
+                    || (parser->max_keys != 0 && ++parser->keys > parser->max_keys);
+                parser->token = TOKEN_KEY;
+                pos++;
+                break;
+            case PARSE_COLON:
+                parser->error = next_char != ':';
+                parser->step = PARSE_VALUE;
+                pos++;
+                break;
+            case PARSE_AFTER_VALUE:
+                if (next_char == ',') {
+                    parser->step = in_object ? PARSE_MEMBER : PARSE_VALUE;
+                } else if (next_char == (in_object ? '}' : ']')) {
+                    pop_container(parser);
+                } else {
+                    parser->error = true;
+                }
+                pos++;
+                break;
+            case PARSE_DONE:
+                // trailing garbage
+                parser->error = true;
+                break;
+        }
+    }
+    return !parser->error;
+}
+
+static struct json_value arena_error = { .type = JSON_ERROR };
+
+struct json_value* json_parser_finish(struct json_parser* parser) {
+    // a number at the very end has no terminating character
+    if (!parser->error && parser->token == TOKEN_NUMBER)
+        end_number(parser, parser->number, parser->number_len);
+
+    struct json_value* result = parser->root;
+    bool complete = !parser->error && parser->step == PARSE_DONE;
+    bool insitu = parser->insitu;
+    struct json_arena* arena = parser->arena;
+    if (arena == NULL && !complete) {
+        // elements of arrays that were still open
+        for (size_t i = 0; i < parser->scratch_len; i++)
+            json_pool_release(parser->scratch[i], !insitu);
+    }
+    if (arena == NULL) {
+        json_pool_free(parser->string, parser->string_capacity);
+        if (parser->scratch != parser->scratch_inline)
+            json_pool_free(parser->scratch, parser->scratch_capacity * sizeof *parser->scratch);
+    }
+    json_parser_init(parser);
+
+    if (complete)
         return result;
 
-    free_json_value(result);
-    return create_json_value(JSON_ERROR);
+    // an arena is released as a whole by its owner, and may be full
+    if (arena != NULL)
+        return &arena_error;
+    json_pool_release(result, !insitu);
+    return json_pool_value(JSON_ERROR);
 }
 
+struct json_value* parse_json(const char* data, const size_t len) {
+    struct json_parser parser;
+    json_parser_init(&parser);
+    json_parser_feed(&parser, data, len);
+    return json_parser_finish(&parser);
+}
+
+struct json_value* parse_json_arena(const char* data, const size_t len, struct json_arena* arena) {
+    struct json_parser parser;
+    json_parser_init(&parser);
+    parser.arena = arena;
+    json_parser_feed(&parser, data, len);
+    return json_parser_finish(&parser);
+}
+
+struct json_value* parse_json_insitu(char* data, const size_t len) {
+    struct json_parser parser;
+    json_parser_init(&parser);
+    parser.insitu = true;
+    json_parser_feed(&parser, data, len);
+    return json_parser_finish(&parser);
+}
+
+void free_json_value_pooled(struct json_value* value) {
+    json_pool_release(value, true);
+}
+
+void free_json_value_insitu(struct json_value* value) {
+    json_pool_release(value, false);
+}
+
+struct json_value* parse_json_segments(const struct json_segment* segments, size_t count) {
+    struct json_parser parser;
+    json_parser_init(&parser);
+    for (size_t i = 0; i < count; i++) {
+        if (!json_parser_feed(&parser, segments[i].data, segments[i].len))
+            break;
+    }
+    return json_parser_finish(&parser);
+}
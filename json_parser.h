@@ -2,8 +2,136 @@
 #define JSON_PARSER_H_
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <uk/config.h>
+#include "json_string.h"
+#include "json_number.h"
+
+// Maximum nesting of objects and arrays accepted by the parsers. The
+// container stack is preallocated with this many entries.
+#ifdef CONFIG_LIBUKDIAGREST_JSON_MAX_DEPTH
+#define JSON_MAX_DEPTH CONFIG_LIBUKDIAGREST_JSON_MAX_DEPTH
+#else
+#define JSON_MAX_DEPTH 32
+#endif
+
+// Array elements the parser holds without allocating
+#define JSON_PARSER_SCRATCH 64
 
 struct json_value;
+struct json_object;
+struct json_arena;
+
+// Where the parser is in the grammar between two tokens
+enum json_parser_step {
+    PARSE_VALUE,
+    PARSE_FIRST_VALUE,  // first element of an array, or ']'
+    PARSE_MEMBER,
+    PARSE_FIRST_MEMBER, // first member of an object, or '}'
+    PARSE_COLON,
+    PARSE_AFTER_VALUE,  // ',' or the closing bracket
+    PARSE_DONE,         // only trailing whitespace is allowed
+};
+
+// The token the parser is in the middle of, if any
+enum json_parser_token {
+    TOKEN_NONE,
+    TOKEN_KEY,
+    TOKEN_STRING,
+    TOKEN_NUMBER,
+    TOKEN_LITERAL,
+};
+
+// An open object or array. Object members are attached as soon as they
+// are created. Array elements are kept on the parser's scratch stack and
+// moved into an exactly sized block when the array is closed, so growing
+// an array never copies more than the stack's amortized doubling.
+struct json_parser_frame {
+    struct json_value* container;
+    // last member of an object, its value is filled in next
+    struct json_object* tail;
+    // scratch stack index of the first element of an array
+    size_t start;
+};
+
+// Resumable (push) parser. The input may be split at any byte, all state
+// needed to continue is kept here between calls to json_parser_feed().
+struct json_parser {
+    struct json_value* root;
+    // scalar whose token is being parsed
+    struct json_value* value;
+    enum json_parser_step step;
+    enum json_parser_token token;
+    bool error;
+    // the error is the arena or the pools running out, not the input
+    bool out_of_memory;
+    // strings are borrowed from the input, see parse_json_insitu()
+    bool insitu;
+    // if set after json_parser_init(), the tree is allocated from this
+    // arena instead of the pools and is released by resetting it
+    struct json_arena* arena;
+    // if set after json_parser_init(), documents with more object members
+    // in total are malformed, as with json_validate()
+    size_t max_keys;
+    size_t keys;
+
+    // string or key being accumulated
+    char* string;
+    size_t string_len;
+    size_t string_capacity;
+    // escape sequence split by a chunk boundary
+    bool escape;
+    char escape_buf[JSON_ESCAPE_MAX];
+    size_t escape_len;
+
+    // number split by a chunk boundary
+    char number[JSON_NUMBER_MAX];
+    size_t number_len;
+
+    // remaining characters of true/false/null
+    const char* literal;
+
+    // elements of the open arrays, in scratch_inline until they outgrow it
+    struct json_value** scratch;
+    size_t scratch_len;
+    size_t scratch_capacity;
+
+    size_t depth;
+    struct json_parser_frame stack[JSON_MAX_DEPTH];
+    struct json_value* scratch_inline[JSON_PARSER_SCRATCH];
+};
+
+void json_parser_init(struct json_parser* parser);
+// Parses the next len bytes of the document. Returns false once the input
+// is known to be malformed, further data is ignored after that.
+bool json_parser_feed(struct json_parser* parser, const char* data, size_t len);
+// Ends the document and returns its value, or a JSON_ERROR value if the
+// input was malformed or incomplete, or memory ran out. Releases all other
+// parser state.
+struct json_value* json_parser_finish(struct json_parser* parser);
+
+// Trees returned by the parsers are built from the node pools (see
+// json_pool.h) and are released with free_json_value_pooled().
 struct json_value* parse_json(const char* data, const size_t len);
+void free_json_value_pooled(struct json_value* value);
+
+// Builds the tree in arena, it is released by resetting the arena
+struct json_value* parse_json_arena(const char* data, const size_t len, struct json_arena* arena);
+
+// Parses data in place: strings and keys of the returned tree point into
+// data, which is modified and has to outlive the tree. No string is
+// allocated. The tree must be released with free_json_value_insitu().
+struct json_value* parse_json_insitu(char* data, const size_t len);
+void free_json_value_insitu(struct json_value* value);
+
+// One contiguous piece of a scattered input, laid out like struct iovec
+struct json_segment {
+    const char* data;
+    size_t len;
+};
+
+// Parses a document scattered over count segments without joining them
+struct json_value* parse_json_segments(const struct json_segment* segments, size_t count);
 
 #endif
@@ -0,0 +1,27 @@
+#include "json_pbuf.h"
+#include "json_parser.h"
+#include <lwip/pbuf.h>
+
+bool json_parser_feed_pbuf(struct json_parser* parser, const struct pbuf* p, size_t offset, size_t len) {
+    for (; p != NULL && len > 0; p = p->next) {
+        if (offset >= p->len) {
+            offset -= p->len;
+            continue;
+        }
+        size_t chunk = p->len - offset;
+        if (chunk > len)
+            chunk = len;
+        if (!json_parser_feed(parser, (const char*) p->payload + offset, chunk))
+            return false;
+        len -= chunk;
+        offset = 0;
+    }
+    return !parser->error;
+}
+
+struct json_value* parse_json_pbuf(const struct pbuf* p) {
+    struct json_parser parser;
+    json_parser_init(&parser);
+    json_parser_feed_pbuf(&parser, p, 0, p->tot_len);
+    return json_parser_finish(&parser);
+}
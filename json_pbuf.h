@@ -0,0 +1,17 @@
+#ifndef JSON_PBUF_H_
+#define JSON_PBUF_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+struct pbuf;
+struct json_parser;
+struct json_value;
+
+// Feeds len bytes of a pbuf chain, starting offset bytes into it, to the
+// parser. The payloads are parsed in place, nothing is copied.
+bool json_parser_feed_pbuf(struct json_parser* parser, const struct pbuf* p, size_t offset, size_t len);
+// Parses a whole document held in a pbuf chain
+struct json_value* parse_json_pbuf(const struct pbuf* p);
+
+#endif
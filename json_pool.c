@@ -0,0 +1,176 @@
+#include "json_pool.h"
+#include "json_intern.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Released blocks are linked through their first word
+struct free_block {
+    struct free_block* next;
+};
+
+struct free_list {
+    struct free_block* head;
+    size_t size;
+    struct json_pool_counters counters;
+};
+
+static struct free_list values = { NULL, sizeof(struct json_value), { 0 } };
+static struct free_list objects = { NULL, sizeof(struct json_object), { 0 } };
+static struct free_list arrays = { NULL, sizeof(struct json_array), { 0 } };
+static struct free_list slabs[JSON_POOL_SLABS] = {
+    { NULL, 16, { 0 } },
+    { NULL, 32, { 0 } },
+    { NULL, 64, { 0 } },
+    { NULL, 128, { 0 } },
+    { NULL, 256, { 0 } },
+    { NULL, 512, { 0 } },
+    { NULL, 1024, { 0 } },
+};
+static size_t large;
+
+static void* list_get(struct free_list* list) {
+    struct free_block* block = list->head;
+    if (block == NULL) {
+        list->counters.misses++;
+        return malloc(list->size);
+    }
+    list->head = block->next;
+    list->counters.hits++;
+    list->counters.free--;
+    return block;
+}
+
+static void list_put(struct free_list* list, void* ptr) {
+    struct free_block* block = ptr;
+    block->next = list->head;
+    list->head = block;
+    list->counters.free++;
+}
+
+static void list_trim(struct free_list* list) {
+    while (list->head != NULL) {
+        struct free_block* block = list->head;
+        list->head = block->next;
+        free(block);
+    }
+    list->counters.free = 0;
+}
+
+// Slab serving size bytes, or NULL if size is left to the heap
+static struct free_list* slab(size_t size) {
+    for (size_t i = 0; i < JSON_POOL_SLABS; i++) {
+        if (size <= slabs[i].size)
+            return &slabs[i];
+    }
+    return NULL;
+}
+
+struct json_value* json_pool_value(enum json_type type) {
+    struct json_value* value = list_get(&values);
+    if (value != NULL) {
+        memset(value, 0, sizeof *value);
+        value->type = type;
+    }
+    return value;
+}
+
+struct json_object* json_pool_object(void) {
+    return list_get(&objects);
+}
+
+struct json_array* json_pool_array(void) {
+    struct json_array* array = list_get(&arrays);
+    if (array != NULL) {
+        array->values = NULL;
+        array->size = 0;
+    }
+    return array;
+}
+
+void* json_pool_alloc(size_t size) {
+    struct free_list* list = slab(size);
+    if (list == NULL) {
+        large++;
+        return malloc(size);
+    }
+    return list_get(list);
+}
+
+void json_pool_free(void* ptr, size_t size) {
+    if (ptr == NULL)
+        return;
+    struct free_list* list = slab(size);
+    if (list == NULL)
+        free(ptr);
+    else
+        list_put(list, ptr);
+}
+
+size_t json_pool_size(size_t size) {
+    struct free_list* list = slab(size);
+    return list == NULL ? size : list->size;
+}
+
+void* json_pool_realloc(void* ptr, size_t old_size, size_t new_size) {
+    struct free_list* old_list = slab(old_size);
+    if (ptr != NULL && old_list == NULL && slab(new_size) == NULL)
+        return realloc(ptr, new_size);
+    if (ptr != NULL && old_list != NULL && old_list == slab(new_size))
+        return ptr;
+    void* block = json_pool_alloc(new_size);
+    if (block == NULL)
+        return NULL;
+    if (ptr != NULL)
+        memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+    json_pool_free(ptr, old_size);
+    return block;
+}
+
+void json_pool_release(struct json_value* value, bool strings) {
+    if (value == NULL)
+        return;
+    switch (value->type) {
+        case JSON_STRING:
+            if (strings && value->string != NULL)
+                json_pool_free(value->string, strlen(value->string) + 1);
+            break;
+        case JSON_OBJECT:
+            for (struct json_object* obj = value->object; obj != NULL; ) {
+                struct json_object* next = obj->next;
+                if (strings && obj->key != NULL && !json_intern_owns(obj->key))
+                    json_pool_free(obj->key, strlen(obj->key) + 1);
+                json_pool_release(obj->value, strings);
+                list_put(&objects, obj);
+                obj = next;
+            }
+            break;
+        case JSON_ARRAY:
+            for (size_t i = 0; i < value->array->size; i++)
+                json_pool_release(value->array->values[i], strings);
+            if (value->array->values != NULL) {
+                json_pool_free(value->array->values, value->array->size * sizeof *value->array->values);
+            }
+            list_put(&arrays, value->array);
+            break;
+        default:
+            break;
+    }
+    list_put(&values, value);
+}
+
+void json_pool_trim(void) {
+    list_trim(&values);
+    list_trim(&objects);
+    list_trim(&arrays);
+    for (size_t i = 0; i < JSON_POOL_SLABS; i++)
+        list_trim(&slabs[i]);
+}
+
+void json_pool_get_stats(struct json_pool_stats* stats) {
+    stats->values = values.counters;
+    stats->objects = objects.counters;
+    stats->arrays = arrays.counters;
+    for (size_t i = 0; i < JSON_POOL_SLABS; i++)
+        stats->slabs[i] = slabs[i].counters;
+    stats->large = large;
+}
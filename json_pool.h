@@ -0,0 +1,64 @@
+#ifndef JSON_POOL_H_
+#define JSON_POOL_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <uk/json_ir.h>
+
+/*
+ * Free-list pools for the nodes of json_value trees. Released nodes stay
+ * on their list instead of going back to the heap, so once the pools have
+ * grown to the peak of a request, later requests do not call malloc() at
+ * all. Variable sized memory (strings, array slots) comes from slabs of
+ * power of two size classes from JSON_POOL_SLAB_MIN to JSON_POOL_SLAB_MAX
+ * bytes; larger blocks are left to the heap.
+ *
+ * The pools are not locked and must only be used by the server thread.
+ * The sampler thread (rest_sampler.h) allocates from its own arena.
+ */
+#define JSON_POOL_SLAB_MIN 16
+#define JSON_POOL_SLAB_MAX 1024
+#define JSON_POOL_SLABS 7
+
+struct json_pool_counters {
+    // allocations served from the free list
+    size_t hits;
+    // allocations that had to call malloc()
+    size_t misses;
+    // blocks currently on the free list
+    size_t free;
+};
+
+struct json_pool_stats {
+    struct json_pool_counters values;
+    struct json_pool_counters objects;
+    struct json_pool_counters arrays;
+    struct json_pool_counters slabs[JSON_POOL_SLABS];
+    // blocks above JSON_POOL_SLAB_MAX, always from the heap
+    size_t large;
+};
+
+struct json_value* json_pool_value(enum json_type type);
+struct json_object* json_pool_object(void);
+// An empty array
+struct json_array* json_pool_array(void);
+
+// Block of at least size bytes. The same size, or any size of the same
+// class, has to be passed back to json_pool_free().
+void* json_pool_alloc(size_t size);
+void json_pool_free(void* ptr, size_t size);
+// Usable size of a block allocated for size bytes
+size_t json_pool_size(size_t size);
+// Moves ptr to a block for new_size bytes, keeping the first old_size.
+// Like realloc(), ptr is left alone if this fails.
+void* json_pool_realloc(void* ptr, size_t old_size, size_t new_size);
+
+// Releases a tree built from the pools to them. The values of its arrays
+// are expected in blocks of exactly their size. Strings and keys are
+// released too unless they were borrowed (strings false) or interned.
+void json_pool_release(struct json_value* value, bool strings);
+// Gives all free blocks back to the heap
+void json_pool_trim(void);
+void json_pool_get_stats(struct json_pool_stats* stats);
+
+#endif
@@ -0,0 +1,85 @@
+#include "json_projection.h"
+#include "json_parser.h"
+#include <ctype.h>
+#include <string.h>
+
+static bool is_name_char(char c) {
+    return c != ',' && c != '{' && c != '}' && !isspace((unsigned char) c);
+}
+
+// Both passes of the parser, nodes is NULL when counting. Returns the
+// number of names, or 0 if text is malformed.
+static size_t parse(const char* text, size_t len, struct json_projection* nodes) {
+    // name each open brace belongs to
+    struct json_projection* parents[JSON_MAX_DEPTH];
+    // last name of the innermost open list, NULL while it is empty
+    struct json_projection* last = NULL;
+    size_t depth = 0;
+    size_t count = 0;
+    size_t pos = 0;
+    bool expect_name = true;
+    // a brace may only follow a name
+    bool after_name = false;
+    for (;;) {
+        while (pos < len && isspace((unsigned char) text[pos]))
+            pos++;
+        if (expect_name) {
+            size_t start = pos;
+            while (pos < len && is_name_char(text[pos]))
+                pos++;
+            if (pos == start)
+                return 0;
+            struct json_projection* node = NULL;
+            if (nodes != NULL) {
+                node = &nodes[count];
+                node->name = &text[start];
+                node->name_len = pos - start;
+                node->fields = NULL;
+                node->next = NULL;
+                if (last != NULL)
+                    last->next = node;
+                else if (depth > 0)
+                    parents[depth - 1]->fields = node;
+            }
+            last = node;
+            count++;
+            expect_name = false;
+            after_name = true;
+            continue;
+        }
+        if (pos == len)
+            return depth == 0 ? count : 0;
+        char c = text[pos++];
+        if (c == ',') {
+            expect_name = true;
+        } else if (c == '{' && after_name && depth < JSON_MAX_DEPTH) {
+            parents[depth++] = last;
+            last = NULL;
+            expect_name = true;
+        } else if (c == '}' && depth > 0) {
+            last = parents[--depth];
+            after_name = false;
+        } else {
+            return 0;
+        }
+    }
+}
+
+size_t json_projection_count(const char* text, size_t len) {
+    return parse(text, len, NULL);
+}
+
+const struct json_projection* json_projection_parse(const char* text, size_t len,
+                                                    struct json_projection* nodes) {
+    parse(text, len, nodes);
+    return nodes;
+}
+
+const struct json_projection* json_projection_find(const struct json_projection* fields,
+                                                   const char* key) {
+    for (; fields != NULL; fields = fields->next) {
+        if (strncmp(key, fields->name, fields->name_len) == 0 && key[fields->name_len] == '\0')
+            return fields;
+    }
+    return NULL;
+}
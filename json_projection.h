@@ -0,0 +1,35 @@
+#ifndef JSON_PROJECTION_H_
+#define JSON_PROJECTION_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Field selection in the style of GraphQL: a comma separated list of
+ * member names, each optionally followed by a selection of its own
+ * members in braces, e.g. "free,threads{id,cpu}". A selection applies to
+ * an object, and to each element of an array; scalars are written as they
+ * are. Members that are not selected are skipped by the serializer, see
+ * json_serialize_projected().
+ */
+struct json_projection {
+    // borrowed from the selection text
+    const char* name;
+    size_t name_len;
+    // selection of the member's own members, NULL to write all of it
+    const struct json_projection* fields;
+    // next name of the same list
+    const struct json_projection* next;
+};
+
+// Number of names in the selection text, or 0 if it is malformed
+size_t json_projection_count(const char* text, size_t len);
+// Builds a selection counted with json_projection_count() in nodes, which
+// has room for that many, and returns its first name
+const struct json_projection* json_projection_parse(const char* text, size_t len,
+                                                    struct json_projection* nodes);
+// Name of the list starting at fields that selects key, or NULL
+const struct json_projection* json_projection_find(const struct json_projection* fields,
+                                                   const char* key);
+
+#endif
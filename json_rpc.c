@@ -0,0 +1,125 @@
+#include "json_rpc.h"
+#include "json_writer.h"
+#include <uk/json_ir.h>
+#include <stdio.h>
+#include <string.h>
+
+void json_rpc_read(const struct json_value* request, struct json_rpc_call* call) {
+    memset(call, 0, sizeof *call);
+    call->notification = true;
+    if (request->type != JSON_OBJECT) {
+        call->error = JSON_RPC_INVALID_REQUEST;
+        call->notification = false;
+        return;
+    }
+    bool version = false;
+    bool fields = true;
+    for (const struct json_object* obj = request->object; obj != NULL; obj = obj->next) {
+        const struct json_value* value = obj->value;
+        if (strcmp(obj->key, "jsonrpc") == 0) {
+            version = value->type == JSON_STRING && strcmp(value->string, "2.0") == 0;
+        } else if (strcmp(obj->key, "method") == 0) {
+            call->method = value->type == JSON_STRING ? value->string : NULL;
+        } else if (strcmp(obj->key, "params") == 0) {
+            call->params = obj->value;
+        } else if (strcmp(obj->key, "fields") == 0) {
+            fields = value->type == JSON_STRING;
+            call->fields = fields ? value->string : NULL;
+        } else if (strcmp(obj->key, "id") == 0) {
+            call->id = value;
+            call->notification = false;
+        }
+    }
+    bool params = call->params == NULL || call->params->type == JSON_OBJECT
+                  || call->params->type == JSON_ARRAY;
+    bool id = call->id == NULL || call->id->type == JSON_STRING || call->id->type == JSON_INT
+              || call->id->type == JSON_NULL;
+    if (!version || call->method == NULL || !params || !id || !fields) {
+        call->error = JSON_RPC_INVALID_REQUEST;
+        // an invalid request is answered even without an id
+        call->notification = false;
+        if (!id)
+            call->id = NULL;
+    }
+}
+
+struct rpc_output {
+    char* buff;
+    size_t len;
+    size_t pos;
+};
+
+static void put(struct rpc_output* out, const char* data, size_t len) {
+    if (out->pos < out->len) {
+        size_t room = out->len - out->pos;
+        memcpy(&out->buff[out->pos], data, len < room ? len : room);
+    }
+    out->pos += len;
+}
+
+static void put_value(struct rpc_output* out, const struct json_value* value,
+                      const struct json_projection* fields) {
+    if (out->pos < out->len)
+        out->pos += json_serialize_projected(&out->buff[out->pos], out->len - out->pos,
+                                             value, fields);
+    else
+        out->pos += json_measure_projected(value, fields);
+}
+
+static const char* error_message(int error) {
+    switch (error) {
+        case JSON_RPC_PARSE_ERROR:
+            return "Parse error";
+        case JSON_RPC_INVALID_REQUEST:
+            return "Invalid Request";
+        case JSON_RPC_METHOD_NOT_FOUND:
+            return "Method not found";
+        case JSON_RPC_INVALID_PARAMS:
+            return "Invalid params";
+        default:
+            return "Call failed";
+    }
+}
+
+#define PUT_LITERAL(out, s) put(out, s, sizeof(s) - 1)
+
+static void put_response(struct rpc_output* out, const struct json_rpc_call* call) {
+    PUT_LITERAL(out, "{\"jsonrpc\":\"2.0\",");
+    if (call->error == 0) {
+        PUT_LITERAL(out, "\"result\":");
+        put_value(out, call->result, call->projection);
+    } else {
+        char error[80];
+        int len = snprintf(error, sizeof error, "\"error\":{\"code\":%d,\"message\":\"%s\"}",
+                           call->error, error_message(call->error));
+        put(out, error, len);
+    }
+    PUT_LITERAL(out, ",\"id\":");
+    // a NULL value is written as null
+    put_value(out, call->id, NULL);
+    PUT_LITERAL(out, "}");
+}
+
+size_t json_rpc_serialize(char* buff, size_t buff_len, const struct json_rpc_call* calls,
+                          size_t count, bool batch) {
+    struct rpc_output out = { buff, buff_len, 0 };
+    size_t responses = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (calls[i].notification)
+            continue;
+        if (responses++ > 0)
+            PUT_LITERAL(&out, ",");
+        else if (batch)
+            PUT_LITERAL(&out, "[");
+        put_response(&out, &calls[i]);
+    }
+    if (responses == 0)
+        return 0;
+    if (batch)
+        PUT_LITERAL(&out, "]");
+    if (out.pos < out.len)
+        out.buff[out.pos] = '\0';
+    else if (out.len > 0)
+        out.buff[out.len - 1] = '\0';
+    return out.pos;
+}
@@ -0,0 +1,46 @@
+#ifndef JSON_RPC_H_
+#define JSON_RPC_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Error codes of JSON-RPC 2.0, and the one used for functions that fail
+#define JSON_RPC_PARSE_ERROR (-32700)
+#define JSON_RPC_INVALID_REQUEST (-32600)
+#define JSON_RPC_METHOD_NOT_FOUND (-32601)
+#define JSON_RPC_INVALID_PARAMS (-32602)
+#define JSON_RPC_CALL_FAILED (-32000)
+
+struct json_value;
+struct json_projection;
+
+// A call of a JSON-RPC 2.0 request and its outcome
+struct json_rpc_call {
+    // borrowed from the request
+    const char* method;
+    struct json_value* params;
+    const struct json_value* id;
+    // selection of the members of the result (see json_projection.h),
+    // NULL for all of them
+    const char* fields;
+    const struct json_projection* projection;
+    // no id member: the call gets no response
+    bool notification;
+    // one of the codes above, 0 if the call succeeded
+    int error;
+    struct json_value* result;
+};
+
+// Reads request into call. call->error is JSON_RPC_INVALID_REQUEST if
+// request is not a valid JSON-RPC 2.0 request object. Besides the members
+// of the specification, a call may have a "fields" string, which is left
+// in call->fields for the caller to build call->projection from.
+void json_rpc_read(const struct json_value* request, struct json_rpc_call* call);
+
+// Serializes the responses to count calls like json_serialize(), as an
+// array if they came in a batch. Notifications are left out; if there is
+// nothing to respond, nothing is written and 0 is returned.
+size_t json_rpc_serialize(char* buff, size_t buff_len, const struct json_rpc_call* calls,
+                          size_t count, bool batch);
+
+#endif
@@ -0,0 +1,140 @@
+#include "json_schema.h"
+#include "json_lazy.h"
+#include "json_string.h"
+#include "json_number.h"
+#include "json_chars.h"
+#include <rest.h>
+#include <uk/json_ir.h>
+#include <stdint.h>
+#include <string.h>
+
+static const struct rest_field* find_field(const struct rest_field* fields, size_t count,
+                                           const char* name) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(fields[i].name, name) == 0)
+            return &fields[i];
+    }
+    return NULL;
+}
+
+static void store_int(void* out, const struct rest_field* field, int64_t integer) {
+    memcpy((char*) out + field->offset, &integer, sizeof integer);
+}
+
+static void store_bool(void* out, const struct rest_field* field, bool boolean) {
+    memcpy((char*) out + field->offset, &boolean, sizeof boolean);
+}
+
+static void store_string(void* out, const struct rest_field* field, const char* string) {
+    memcpy((char*) out + field->offset, &string, sizeof string);
+}
+
+// Decodes the value at data[pos] into field. Returns the position after
+// it, or 0 if it does not have the type of the field.
+static size_t decode_field(char* data, size_t len, size_t pos, const struct rest_field* field,
+                           void* out) {
+    if (data[pos] == 'n')
+        return len - pos >= 4 && json_literal_matches(&data[pos]) ? pos + 4 : 0;
+    switch (field->type) {
+        case REST_FIELD_INT: {
+            size_t span = json_number_span(&data[pos], len - pos);
+            struct json_number number;
+            int64_t integer;
+            if (span == 0 || json_parse_number(&data[pos], span, &number) != span
+                || !json_number_to_int(&number, &integer))
+                return 0;
+            store_int(out, field, integer);
+            return pos + span;
+        }
+        case REST_FIELD_BOOL: {
+            size_t literal_len = json_literal_len(data[pos]);
+            if (literal_len == 0 || len - pos < literal_len
+                || !json_literal_matches(&data[pos]))
+                return 0;
+            store_bool(out, field, data[pos] == 't');
+            return pos + literal_len;
+        }
+        case REST_FIELD_STRING: {
+            if (data[pos] != '"')
+                return 0;
+            size_t end = json_string_insitu(data, len, pos + 1);
+            if (end != 0)
+                store_string(out, field, &data[pos + 1]);
+            return end;
+        }
+    }
+    return 0;
+}
+
+bool json_schema_decode(char* data, size_t len, const struct rest_field* fields,
+                        size_t count, void* out) {
+    size_t pos = json_skip_ws(data, len, 0);
+    if (pos < len && data[pos] == 'n')
+        return len - pos >= 4 && json_literal_matches(&data[pos]);
+    if (pos == len || data[pos] != '{')
+        return false;
+    pos = json_skip_ws(data, len, pos + 1);
+    if (pos < len && data[pos] == '}')
+        return true;
+
+    for (;;) {
+        if (pos == len || data[pos] != '"')
+            return false;
+        const char* key = &data[pos + 1];
+        pos = json_string_insitu(data, len, pos + 1);
+        if (pos == 0)
+            return false;
+        pos = json_skip_ws(data, len, pos);
+        if (pos == len || data[pos] != ':')
+            return false;
+        pos = json_skip_ws(data, len, pos + 1);
+        if (pos == len)
+            return false;
+        const struct rest_field* field = find_field(fields, count, key);
+        if (field != NULL)
+            pos = decode_field(data, len, pos, field, out);
+        else
+            pos = json_skip_value(data, len, pos);
+        if (pos == 0)
+            return false;
+        pos = json_skip_ws(data, len, pos);
+        if (pos == len)
+            return false;
+        if (data[pos] == '}')
+            return true;
+        if (data[pos] != ',')
+            return false;
+        pos = json_skip_ws(data, len, pos + 1);
+    }
+}
+
+bool json_schema_decode_value(const struct json_value* value, const struct rest_field* fields,
+                              size_t count, void* out) {
+    if (value->type == JSON_NULL)
+        return true;
+    if (value->type != JSON_OBJECT)
+        return false;
+    for (const struct json_object* obj = value->object; obj != NULL; obj = obj->next) {
+        const struct rest_field* field = find_field(fields, count, obj->key);
+        if (field == NULL || obj->value->type == JSON_NULL)
+            continue;
+        switch (field->type) {
+            case REST_FIELD_INT:
+                if (obj->value->type != JSON_INT)
+                    return false;
+                store_int(out, field, obj->value->integer);
+                break;
+            case REST_FIELD_BOOL:
+                if (obj->value->type != JSON_TRUE && obj->value->type != JSON_FALSE)
+                    return false;
+                store_bool(out, field, obj->value->type == JSON_TRUE);
+                break;
+            case REST_FIELD_STRING:
+                if (obj->value->type != JSON_STRING)
+                    return false;
+                store_string(out, field, obj->value->string);
+                break;
+        }
+    }
+    return true;
+}
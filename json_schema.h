@@ -0,0 +1,27 @@
+#ifndef JSON_SCHEMA_H_
+#define JSON_SCHEMA_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Decoding of a parameters object into a C struct described by a table of
+ * struct rest_field. out has to be zeroed by the caller: members that are
+ * missing or null leave their field alone, members without a field are
+ * skipped, and a later duplicate overwrites an earlier one. Both return
+ * false if the parameters are not an object (or null) or a member does not
+ * have the type of its field, in which case out is partly filled in.
+ */
+
+struct json_value;
+struct rest_field;
+
+// Decodes the unparsed value in data, which has been validated. Strings
+// are unescaped in place and borrowed from data.
+bool json_schema_decode(char* data, size_t len, const struct rest_field* fields,
+                        size_t count, void* out);
+// Same for a parsed value, whose strings are borrowed
+bool json_schema_decode_value(const struct json_value* value, const struct rest_field* fields,
+                              size_t count, void* out);
+
+#endif
@@ -0,0 +1,233 @@
+#include "json_string.h"
+#include "json_chars.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+size_t json_string_run(const char* data, size_t len) {
+    size_t pos = 0;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for (; pos + 16 <= len; pos += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*) &data[pos]);
+        // unsigned block <= 0x1f
+        __m128i special = _mm_cmpeq_epi8(_mm_min_epu8(block, control), block);
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(block, quote));
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(block, backslash));
+        int mask = _mm_movemask_epi8(special);
+        if (mask != 0)
+            return pos + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t control = vdupq_n_u8(0x20);
+    for (; pos + 16 <= len; pos += 16) {
+        uint8x16_t block = vld1q_u8((const uint8_t*) &data[pos]);
+        uint8x16_t special = vcltq_u8(block, control);
+        special = vorrq_u8(special, vceqq_u8(block, quote));
+        special = vorrq_u8(special, vceqq_u8(block, backslash));
+        // the scalar loop below locates the byte within the block
+        if (vmaxvq_u8(special) != 0)
+            break;
+    }
+#endif
+    while (pos < len && !(json_char_class[(unsigned char) data[pos]] & JSON_CHAR_STRING))
+        pos++;
+    return pos;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static int32_t parse_hex4(const char* data) {
+    int32_t code = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_digit(data[i]);
+        if (digit < 0)
+            return -1;
+        code = code << 4 | digit;
+    }
+    return code;
+}
+
+static int encode_utf8(uint32_t code, char* out) {
+    if (code < 0x80) {
+        out[0] = code;
+        return 1;
+    }
+    if (code < 0x800) {
+        out[0] = 0xc0 | code >> 6;
+        out[1] = 0x80 | (code & 0x3f);
+        return 2;
+    }
+    if (code < 0x10000) {
+        out[0] = 0xe0 | code >> 12;
+        out[1] = 0x80 | (code >> 6 & 0x3f);
+        out[2] = 0x80 | (code & 0x3f);
+        return 3;
+    }
+    out[0] = 0xf0 | code >> 18;
+    out[1] = 0x80 | (code >> 12 & 0x3f);
+    out[2] = 0x80 | (code >> 6 & 0x3f);
+    out[3] = 0x80 | (code & 0x3f);
+    return 4;
+}
+
+int json_decode_escape(const char* data, size_t len, size_t* used, char* out) {
+    if (len == 0)
+        return 0;
+    *used = 1;
+    switch (data[0]) {
+        case '"':
+        case '\\':
+        case '/':
+            out[0] = data[0];
+            return 1;
+        case 'b':
+            out[0] = '\b';
+            return 1;
+        case 'f':
+            out[0] = '\f';
+            return 1;
+        case 'n':
+            out[0] = '\n';
+            return 1;
+        case 'r':
+            out[0] = '\r';
+            return 1;
+        case 't':
+            out[0] = '\t';
+            return 1;
+        case 'u':
+            break;
+        default:
+            return -1;
+    }
+
+    if (len < 5)
+        return 0;
+    int32_t code = parse_hex4(&data[1]);
+    if (code < 0)
+        return -1;
+    if (code >= 0xdc00 && code <= 0xdfff) {
+        // low surrogate without a high one
+        return -1;
+    }
+    if (code >= 0xd800 && code <= 0xdbff) {
+        // a high surrogate has to be followed by an escaped low surrogate
+        if ((len > 5 && data[5] != '\\') || (len > 6 && data[6] != 'u'))
+            return -1;
+        if (len < JSON_ESCAPE_MAX)
+            return 0;
+        int32_t low = parse_hex4(&data[7]);
+        if (low < 0xdc00 || low > 0xdfff)
+            return -1;
+        *used = JSON_ESCAPE_MAX;
+        return encode_utf8(0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00), out);
+    }
+    *used = 5;
+    return encode_utf8(code, out);
+}
+
+// Length of the well-formed UTF-8 sequence starting at s, or 0
+static size_t utf8_sequence(const unsigned char* s, size_t len) {
+    unsigned char c = s[0];
+    unsigned char low = 0x80, high = 0xbf;
+    size_t n;
+    if (c < 0x80)
+        return 1;
+    if (c < 0xc2)
+        return 0;
+    if (c < 0xe0) {
+        n = 2;
+    } else if (c < 0xf0) {
+        n = 3;
+        if (c == 0xe0)
+            low = 0xa0; // overlong
+        else if (c == 0xed)
+            high = 0x9f; // surrogates
+    } else if (c < 0xf5) {
+        n = 4;
+        if (c == 0xf0)
+            low = 0x90; // overlong
+        else if (c == 0xf4)
+            high = 0x8f; // above U+10FFFF
+    } else {
+        return 0;
+    }
+    if (len < n || s[1] < low || s[1] > high)
+        return 0;
+    for (size_t i = 2; i < n; i++) {
+        if ((s[i] & 0xc0) != 0x80)
+            return 0;
+    }
+    return n;
+}
+
+bool json_utf8_valid(const char* data, size_t len) {
+    const unsigned char* s = (const unsigned char*) data;
+    size_t pos = 0;
+    while (pos < len) {
+        // skip blocks of ASCII, which is what nearly all our strings are
+#if defined(__SSE2__)
+        while (pos + 16 <= len
+               && _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) &s[pos])) == 0)
+            pos += 16;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        while (pos + 16 <= len && vmaxvq_u8(vld1q_u8(&s[pos])) < 0x80)
+            pos += 16;
+#endif
+        // then validate up to the end of the block that stopped the skip
+        size_t end = pos + 16 < len ? pos + 16 : len;
+        while (pos < end) {
+            size_t n = utf8_sequence(&s[pos], len - pos);
+            if (n == 0)
+                return false;
+            pos += n;
+        }
+    }
+    return true;
+}
+
+size_t json_string_insitu(char* data, size_t len, size_t pos) {
+    char* string = &data[pos];
+    size_t out = pos;
+    while (pos < len) {
+        size_t run = json_string_run(&data[pos], len - pos);
+        if (out != pos)
+            memmove(&data[out], &data[pos], run);
+        out += run;
+        pos += run;
+        if (pos == len || data[pos] != '\\')
+            break;
+        pos++; // backslash
+        char decoded[4];
+        size_t used;
+        int count = json_decode_escape(&data[pos], len - pos, &used, decoded);
+        if (count <= 0 || (count == 1 && decoded[0] == '\0'))
+            return 0;
+        // the decoded sequence is never longer than the escaped one
+        memcpy(&data[out], decoded, count);
+        out += count;
+        pos += used;
+    }
+    if (pos == len || data[pos] != '"' || !json_utf8_valid(string, &data[out] - string))
+        return 0;
+    data[out] = '\0';
+    return pos + 1;
+}
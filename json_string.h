@@ -0,0 +1,30 @@
+#ifndef JSON_STRING_H_
+#define JSON_STRING_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Longest escape sequence after the backslash: a surrogate pair "uD83D\uDE00"
+#define JSON_ESCAPE_MAX 11
+
+// Length of the leading part of data that can be copied into a string
+// verbatim, that is up to the first '"', '\\' or control character.
+size_t json_string_run(const char* data, size_t len);
+
+// Decodes the escape sequence following a backslash into UTF-8. Returns the
+// number of bytes written to out (at most 4) and sets *used to the number of
+// input bytes consumed. Returns 0 if data ends before the sequence does and
+// -1 if the sequence is invalid, including unpaired surrogates.
+int json_decode_escape(const char* data, size_t len, size_t* used, char* out);
+
+// Unescapes the string starting at data[pos], just past its opening quote,
+// where it lies and terminates it by overwriting the closing quote. Plain
+// strings are not moved. Returns the position after the closing quote, or
+// 0 if the string is malformed or does not end before len.
+size_t json_string_insitu(char* data, size_t len, size_t pos);
+
+// Checks that data is well-formed UTF-8 (no overlong forms, surrogates or
+// code points above U+10FFFF).
+bool json_utf8_valid(const char* data, size_t len);
+
+#endif
@@ -0,0 +1,513 @@
+#include "json_tape.h"
+#include "json_parser.h"
+#include "json_string.h"
+#include "json_number.h"
+#include "json_chars.h"
+#include <uk/json_ir.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAPE_PAYLOAD_MASK ((UINT64_C(1) << 56) - 1)
+
+struct json_tape_state {
+    const char* data;
+    size_t len;
+    size_t pos;
+    struct json_tape* tape;
+    size_t capacity;
+    size_t strings_capacity;
+    // index of the start word of the innermost open container, the start
+    // words of open containers link to their parent through their payload
+    size_t open;
+    size_t depth;
+    bool borrow;
+    bool error;
+};
+
+enum json_tape_step {
+    TAPE_VALUE,
+    TAPE_KEY,
+    TAPE_AFTER_VALUE,
+    TAPE_DONE,
+};
+
+static void emit(struct json_tape_state* state, enum json_tape_type type, uint64_t payload) {
+    if (state->tape->size == state->capacity) {
+        state->error = true;
+        return;
+    }
+    state->tape->words[state->tape->size++] = ((uint64_t) type << 56) | (payload & TAPE_PAYLOAD_MASK);
+}
+
+static void skip_ws(struct json_tape_state* state) {
+    state->pos = json_skip_ws(state->data, state->len, state->pos);
+}
+
+static void tape_open(struct json_tape_state* state, enum json_tape_type type) {
+    if (state->depth == JSON_MAX_DEPTH) {
+        state->error = true;
+        return;
+    }
+    size_t start = state->tape->size;
+    // the payload is patched to point past the end word once we close
+    emit(state, type, state->open);
+    state->open = start;
+    state->depth++;
+    if (state->depth > state->tape->max_depth)
+        state->tape->max_depth = state->depth;
+    state->pos++;
+}
+
+static void tape_close(struct json_tape_state* state) {
+    size_t start = state->open;
+    enum json_tape_type type = json_tape_type(state->tape, start);
+    size_t parent = json_tape_payload(state->tape, start);
+    emit(state, type == JSON_TAPE_OBJECT ? JSON_TAPE_OBJECT_END : JSON_TAPE_ARRAY_END, start);
+    if (state->error)
+        return;
+    state->tape->words[start] = ((uint64_t) type << 56) | state->tape->size;
+    state->open = parent;
+    state->depth--;
+    state->pos++;
+}
+
+// Emits a view of a plain string, returns false if it has to be copied
+static bool tape_string_view(struct json_tape_state* state) {
+    size_t start = state->pos;
+    size_t end = start + json_string_run(&state->data[start], state->len - start);
+    if (end == state->len || state->data[end] != '"'
+        || end - start > JSON_TAPE_BORROWED_MAX_LEN || start > UINT32_MAX)
+        return false;
+    if (!json_utf8_valid(&state->data[start], end - start)) {
+        state->error = true;
+        return true;
+    }
+    emit(state, JSON_TAPE_STRING, JSON_TAPE_BORROWED | ((uint64_t) (end - start) << 32) | start);
+    state->pos = end + 1; // "
+    return true;
+}
+
+static void tape_string(struct json_tape_state* state) {
+    struct json_tape* tape = state->tape;
+    state->pos++; // "
+    if (state->borrow && tape_string_view(state))
+        return;
+    size_t offset = tape->strings_len;
+    // leave room for the length prefix, filled in once we know it
+    size_t out = offset + sizeof(uint32_t);
+    while (state->pos < state->len) {
+        // plain runs are copied as a block
+        size_t run = json_string_run(&state->data[state->pos], state->len - state->pos);
+        if (out + run + 4 >= state->strings_capacity) {
+            state->error = true;
+            return;
+        }
+        memcpy(&tape->strings[out], &state->data[state->pos], run);
+        out += run;
+        state->pos += run;
+        if (state->pos == state->len || state->data[state->pos] != '\\')
+            break;
+        state->pos++; // backslash
+        size_t used;
+        int count = json_decode_escape(&state->data[state->pos], state->len - state->pos,
+                                       &used, &tape->strings[out]);
+        if (count <= 0) {
+            state->error = true;
+            return;
+        }
+        out += count;
+        state->pos += used;
+    }
+    if (state->pos == state->len || state->data[state->pos] != '"'
+        || !json_utf8_valid(&tape->strings[offset + sizeof(uint32_t)], out - offset - sizeof(uint32_t))) {
+        state->error = true;
+        return;
+    }
+    state->pos++; // "
+    uint32_t count = out - offset - sizeof(uint32_t);
+    memcpy(&tape->strings[offset], &count, sizeof count);
+    tape->strings[out++] = '\0';
+    tape->strings_len = out;
+    emit(state, JSON_TAPE_STRING, offset);
+}
+
+static void tape_number(struct json_tape_state* state) {
+    struct json_number number;
+    size_t span = json_number_span(&state->data[state->pos], state->len - state->pos);
+    if (span == 0 || json_parse_number(&state->data[state->pos], span, &number) != span) {
+        state->error = true;
+        return;
+    }
+    state->pos += span;
+    uint64_t word;
+    switch (number.type) {
+        case JSON_NUMBER_INT:
+            emit(state, JSON_TAPE_INT, 0);
+            word = (uint64_t) number.integer;
+            break;
+        case JSON_NUMBER_UINT:
+            emit(state, JSON_TAPE_UINT, 0);
+            word = number.uinteger;
+            break;
+        default:
+            emit(state, JSON_TAPE_DOUBLE, 0);
+            memcpy(&word, &number.real, sizeof word);
+    }
+    if (state->error)
+        return;
+    if (state->tape->size == state->capacity) {
+        state->error = true;
+        return;
+    }
+    state->tape->words[state->tape->size++] = word;
+}
+
+static void tape_literal(struct json_tape_state* state, enum json_tape_type type) {
+    size_t literal_len = json_literal_len(state->data[state->pos]);
+    if (state->len - state->pos < literal_len || !json_literal_matches(&state->data[state->pos])) {
+        state->error = true;
+        return;
+    }
+    state->pos += literal_len;
+    emit(state, type, 0);
+}
+
+// Parses the value at the current position. Returns the next step.
+static enum json_tape_step tape_value(struct json_tape_state* state) {
+    skip_ws(state);
+    if (state->pos == state->len) {
+        state->error = true;
+        return TAPE_DONE;
+    }
+    switch (state->data[state->pos]) {
+        case '{':
+            tape_open(state, JSON_TAPE_OBJECT);
+            if (state->error)
+                return TAPE_DONE;
+            skip_ws(state);
+            if (state->pos < state->len && state->data[state->pos] == '}') {
+                // This is an empty object
+                tape_close(state);
+                return TAPE_AFTER_VALUE;
+            }
+            return TAPE_KEY;
+        case '[':
+            tape_open(state, JSON_TAPE_ARRAY);
+            if (state->error)
+                return TAPE_DONE;
+            skip_ws(state);
+            if (state->pos < state->len && state->data[state->pos] == ']') {
+                // This is an empty array
+                tape_close(state);
+                return TAPE_AFTER_VALUE;
+            }
+            return TAPE_VALUE;
+        case '"':
+            tape_string(state);
+            break;
+        case 't':
+            tape_literal(state, JSON_TAPE_TRUE);
+            break;
+        case 'f':
+            tape_literal(state, JSON_TAPE_FALSE);
+            break;
+        case 'n':
+            tape_literal(state, JSON_TAPE_NULL);
+            break;
+        default:
+            tape_number(state);
+    }
+    return TAPE_AFTER_VALUE;
+}
+
+static enum json_tape_step tape_key(struct json_tape_state* state) {
+    skip_ws(state);
+    if (state->pos == state->len || state->data[state->pos] != '"') {
+        state->error = true;
+        return TAPE_DONE;
+    }
+    tape_string(state);
+    skip_ws(state);
+    if (state->pos == state->len || state->data[state->pos] != ':') {
+        state->error = true;
+        return TAPE_DONE;
+    }
+    state->pos++; // :
+    return TAPE_VALUE;
+}
+
+static enum json_tape_step tape_after_value(struct json_tape_state* state) {
+    if (state->depth == 0)
+        return TAPE_DONE;
+    skip_ws(state);
+    if (state->pos == state->len) {
+        state->error = true;
+        return TAPE_DONE;
+    }
+    bool in_object = json_tape_type(state->tape, state->open) == JSON_TAPE_OBJECT;
+    char next_char = state->data[state->pos];
+    if (next_char == ',') {
+        state->pos++; // ,
+        return in_object ? TAPE_KEY : TAPE_VALUE;
+    }
+    if (next_char == (in_object ? '}' : ']')) {
+        tape_close(state);
+        return TAPE_AFTER_VALUE;
+    }
+    state->error = true;
+    return TAPE_DONE;
+}
+
+static bool tape_parse(const char* data, const size_t len, struct json_tape* tape, bool borrow) {
+    memset(tape, 0, sizeof *tape);
+    if (len == 0)
+        return false;
+
+    // Every value takes at least as many input bytes as tape words, except
+    // for numbers which take two words but are always followed by a
+    // separator or closing bracket. Strings grow by at most their length
+    // prefix and terminator, which is less than two bytes per input byte.
+    size_t capacity = len + 3;
+    size_t strings_capacity = 2 * len + 8;
+    void* mem = malloc(capacity * sizeof *tape->words + strings_capacity);
+    if (mem == NULL)
+        return false;
+    tape->words = mem;
+    tape->strings = (char*) &tape->words[capacity];
+    tape->input = borrow ? data : NULL;
+
+    struct json_tape_state state = {
+        .data = data,
+        .len = len,
+        .pos = 0,
+        .tape = tape,
+        .capacity = capacity,
+        .strings_capacity = strings_capacity,
+        .open = 0,
+        .depth = 0,
+        .borrow = borrow,
+        .error = false,
+    };
+    enum json_tape_step step = TAPE_VALUE;
+    while (step != TAPE_DONE && !state.error) {
+        switch (step) {
+            case TAPE_VALUE:
+                step = tape_value(&state);
+                break;
+            case TAPE_KEY:
+                step = tape_key(&state);
+                break;
+            case TAPE_AFTER_VALUE:
+                step = tape_after_value(&state);
+                break;
+            case TAPE_DONE:
+                break;
+        }
+    }
+    skip_ws(&state);
+    if (state.error || state.pos != state.len) {
+        free_json_tape(tape);
+        return false;
+    }
+    return true;
+}
+
+bool parse_json_tape(const char* data, const size_t len, struct json_tape* tape) {
+    return tape_parse(data, len, tape, false);
+}
+
+bool parse_json_tape_borrowed(const char* data, const size_t len, struct json_tape* tape) {
+    return tape_parse(data, len, tape, true);
+}
+
+void free_json_tape(struct json_tape* tape) {
+    free(tape->words);
+    memset(tape, 0, sizeof *tape);
+}
+
+size_t json_tape_next(const struct json_tape* tape, size_t idx) {
+    switch (json_tape_type(tape, idx)) {
+        case JSON_TAPE_OBJECT:
+        case JSON_TAPE_ARRAY:
+            return json_tape_payload(tape, idx);
+        case JSON_TAPE_INT:
+        case JSON_TAPE_UINT:
+        case JSON_TAPE_DOUBLE:
+            return idx + 2;
+        default:
+            return idx + 1;
+    }
+}
+
+bool json_tape_is_end(const struct json_tape* tape, size_t idx) {
+    enum json_tape_type type = json_tape_type(tape, idx);
+    return type == JSON_TAPE_OBJECT_END || type == JSON_TAPE_ARRAY_END;
+}
+
+int64_t json_tape_int(const struct json_tape* tape, size_t idx) {
+    return (int64_t) tape->words[idx + 1];
+}
+
+uint64_t json_tape_uint(const struct json_tape* tape, size_t idx) {
+    return tape->words[idx + 1];
+}
+
+double json_tape_double(const struct json_tape* tape, size_t idx) {
+    double real;
+    memcpy(&real, &tape->words[idx + 1], sizeof real);
+    return real;
+}
+
+const char* json_tape_string(const struct json_tape* tape, size_t idx, size_t* len) {
+    uint64_t payload = json_tape_payload(tape, idx);
+    if (payload & JSON_TAPE_BORROWED) {
+        if (len != NULL)
+            *len = (payload >> 32) & JSON_TAPE_BORROWED_MAX_LEN;
+        return &tape->input[payload & UINT32_MAX];
+    }
+    const char* string = &tape->strings[json_tape_payload(tape, idx)];
+    if (len != NULL) {
+        uint32_t count;
+        memcpy(&count, string, sizeof count);
+        *len = count;
+    }
+    return string + sizeof(uint32_t);
+}
+
+size_t json_tape_count(const struct json_tape* tape, size_t idx) {
+    bool is_object = json_tape_type(tape, idx) == JSON_TAPE_OBJECT;
+    size_t count = 0;
+    for (idx++; !json_tape_is_end(tape, idx); count++) {
+        if (is_object)
+            idx++; // key
+        idx = json_tape_next(tape, idx);
+    }
+    return count;
+}
+
+size_t json_tape_find(const struct json_tape* tape, size_t idx, const char* key) {
+    size_t key_len = strlen(key);
+    for (idx++; !json_tape_is_end(tape, idx); idx = json_tape_next(tape, idx + 1)) {
+        size_t len;
+        const char* member = json_tape_string(tape, idx, &len);
+        if (len == key_len && memcmp(member, key, len) == 0)
+            return idx + 1;
+    }
+    return 0;
+}
+
+static char* copy_string(const struct json_tape* tape, size_t idx) {
+    size_t len;
+    const char* string = json_tape_string(tape, idx, &len);
+    char* copy = malloc(len + 1);
+    memcpy(copy, string, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+struct tape_frame {
+    struct json_value* container;
+    struct json_object* tail;
+};
+
+static struct json_value* scalar_to_value(const struct json_tape* tape, size_t idx) {
+    struct json_value* value;
+    struct json_number number;
+    switch (json_tape_type(tape, idx)) {
+        case JSON_TAPE_NULL:
+            return create_json_value(JSON_NULL);
+        case JSON_TAPE_TRUE:
+            return create_json_value(JSON_TRUE);
+        case JSON_TAPE_FALSE:
+            return create_json_value(JSON_FALSE);
+        case JSON_TAPE_INT:
+            value = create_json_value(JSON_INT);
+            value->integer = json_tape_int(tape, idx);
+            return value;
+        case JSON_TAPE_UINT:
+        case JSON_TAPE_DOUBLE:
+            // the tree only holds int64_t, anything else becomes an error leaf
+            if (json_tape_type(tape, idx) == JSON_TAPE_UINT) {
+                number.type = JSON_NUMBER_UINT;
+                number.uinteger = json_tape_uint(tape, idx);
+            } else {
+                number.type = JSON_NUMBER_DOUBLE;
+                number.real = json_tape_double(tape, idx);
+            }
+            value = create_json_value(JSON_ERROR);
+            if (json_number_to_int(&number, &value->integer))
+                value->type = JSON_INT;
+            return value;
+        case JSON_TAPE_STRING:
+            value = create_json_value(JSON_STRING);
+            value->string = copy_string(tape, idx);
+            return value;
+        default:
+            return create_json_value(JSON_ERROR);
+    }
+}
+
+struct json_value* json_tape_to_value(const struct json_tape* tape, size_t idx) {
+    // Walk the tape iteratively, the nesting depth is attacker controlled
+    struct tape_frame* frames = malloc((tape->max_depth + 1) * sizeof *frames);
+    size_t depth = 0;
+    struct json_value* root = NULL;
+    do {
+        char* key = NULL;
+        if (depth > 0 && frames[depth - 1].container->type == JSON_OBJECT) {
+            key = copy_string(tape, idx);
+            idx++;
+        }
+
+        struct json_value* value;
+        enum json_tape_type type = json_tape_type(tape, idx);
+        if (type == JSON_TAPE_OBJECT) {
+            value = create_json_value(JSON_OBJECT);
+            value->object = NULL;
+        } else if (type == JSON_TAPE_ARRAY) {
+            value = create_json_value(JSON_ARRAY);
+            size_t size = json_tape_count(tape, idx);
+            value->array = malloc(sizeof *value->array);
+            value->array->size = 0;
+            value->array->values = size > 0 ? malloc(size * sizeof *value->array->values) : NULL;
+        } else {
+            value = scalar_to_value(tape, idx);
+        }
+
+        // attach to the enclosing container
+        if (depth == 0) {
+            root = value;
+        } else if (key != NULL) {
+            struct tape_frame* frame = &frames[depth - 1];
+            struct json_object* member = malloc(sizeof *member);
+            member->key = key;
+            member->value = value;
+            member->next = NULL;
+            if (frame->tail == NULL)
+                frame->container->object = member;
+            else
+                frame->tail->next = member;
+            frame->tail = member;
+        } else {
+            struct json_array* array = frames[depth - 1].container->array;
+            array->values[array->size++] = value;
+        }
+
+        if (type == JSON_TAPE_OBJECT || type == JSON_TAPE_ARRAY) {
+            frames[depth].container = value;
+            frames[depth].tail = NULL;
+            depth++;
+            idx++;
+        } else {
+            idx = json_tape_next(tape, idx);
+        }
+
+        // leave every container we just finished
+        while (depth > 0 && json_tape_is_end(tape, idx)) {
+            depth--;
+            idx++;
+        }
+    } while (depth > 0);
+    free(frames);
+    return root;
+}
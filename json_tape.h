@@ -0,0 +1,98 @@
+#ifndef JSON_TAPE_H_
+#define JSON_TAPE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Flat "tape" representation of a parsed JSON document.
+ *
+ * The document is stored as one contiguous array of 64-bit words in
+ * document order. The top 8 bits of a word hold its tag (one of
+ * enum json_tape_type), the low 56 bits a tag-specific payload:
+ *
+ *   null/true/false  unused
+ *   int/uint/double  unused, the value is stored in the following word
+ *   string           offset of the string in the string buffer, which holds
+ *                    a 32-bit length, the bytes and a terminating '\0'.
+ *                    Borrowed strings have JSON_TAPE_BORROWED set and hold
+ *                    their offset in the input (low 32 bits) and length
+ *                    (next 23 bits) instead
+ *   object/array     on the start word: index one past the matching end
+ *                    word, on the end word: index of the start word
+ *
+ * Object members are stored as a string word (the key) followed by the
+ * value. The root value always starts at index 0.
+ */
+enum json_tape_type {
+    JSON_TAPE_NULL = 'n',
+    JSON_TAPE_TRUE = 't',
+    JSON_TAPE_FALSE = 'f',
+    JSON_TAPE_INT = 'l',
+    JSON_TAPE_UINT = 'u',
+    JSON_TAPE_DOUBLE = 'd',
+    JSON_TAPE_STRING = '"',
+    JSON_TAPE_OBJECT = '{',
+    JSON_TAPE_OBJECT_END = '}',
+    JSON_TAPE_ARRAY = '[',
+    JSON_TAPE_ARRAY_END = ']',
+};
+
+#define JSON_TAPE_BORROWED (UINT64_C(1) << 55)
+#define JSON_TAPE_BORROWED_MAX_LEN ((UINT64_C(1) << 23) - 1)
+
+struct json_tape {
+    // input of a borrowed tape, see parse_json_tape_borrowed()
+    const char* input;
+    uint64_t* words;
+    size_t size;
+    char* strings;
+    size_t strings_len;
+    size_t max_depth;
+};
+
+struct json_value;
+
+// Parses data into tape. Both the tape and the string buffer are carved out
+// of a single allocation sized from len. Returns false on malformed input,
+// in which case tape holds nothing that needs freeing.
+bool parse_json_tape(const char* data, const size_t len, struct json_tape* tape);
+// Like parse_json_tape(), but strings without escapes are not copied: they
+// are kept as (offset, length) views into data, which has to outlive the
+// tape. Only strings with escapes go to the string buffer.
+bool parse_json_tape_borrowed(const char* data, const size_t len, struct json_tape* tape);
+void free_json_tape(struct json_tape* tape);
+
+static inline enum json_tape_type json_tape_type(const struct json_tape* tape, size_t idx) {
+    return (enum json_tape_type) (tape->words[idx] >> 56);
+}
+
+static inline uint64_t json_tape_payload(const struct json_tape* tape, size_t idx) {
+    return tape->words[idx] & ((UINT64_C(1) << 56) - 1);
+}
+
+// Index of the value following the one at idx (skips whole containers).
+size_t json_tape_next(const struct json_tape* tape, size_t idx);
+// True if idx is the end word of the container it is iterating over.
+bool json_tape_is_end(const struct json_tape* tape, size_t idx);
+
+int64_t json_tape_int(const struct json_tape* tape, size_t idx);
+uint64_t json_tape_uint(const struct json_tape* tape, size_t idx);
+double json_tape_double(const struct json_tape* tape, size_t idx);
+// Returns the string at idx and its length. Borrowed strings are not '\0'
+// terminated, use the length.
+const char* json_tape_string(const struct json_tape* tape, size_t idx, size_t* len);
+
+// Number of elements (or members) of the container starting at idx.
+size_t json_tape_count(const struct json_tape* tape, size_t idx);
+// Index of the value stored under key in the object starting at idx, or 0
+// if the key is not present.
+size_t json_tape_find(const struct json_tape* tape, size_t idx, const char* key);
+
+// Builds a heap allocated json_value tree of the value starting at idx, to
+// be released with free_json_value(). Numbers that do not fit the int64_t
+// of a JSON_INT value become JSON_ERROR leaves.
+struct json_value* json_tape_to_value(const struct json_tape* tape, size_t idx);
+
+#endif
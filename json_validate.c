@@ -0,0 +1,189 @@
+#include "json_validate.h"
+#include "json_parser.h"
+#include "json_string.h"
+#include "json_number.h"
+#include "json_chars.h"
+#include <stdint.h>
+
+enum json_validate_step {
+    VALIDATE_VALUE,
+    VALIDATE_KEY,
+    VALIDATE_AFTER_VALUE,
+    VALIDATE_DONE,
+};
+
+struct json_validate_state {
+    const char* data;
+    size_t len;
+    size_t pos;
+    size_t max_depth;
+    size_t max_keys;
+    size_t keys;
+    bool error;
+    size_t depth;
+    // whether each open container is an object
+    bool objects[JSON_MAX_DEPTH];
+};
+
+static void validate_string(struct json_validate_state* state) {
+    const char* data = state->data;
+    size_t len = state->len;
+    size_t pos = state->pos + 1; // opening quote
+    for (;;) {
+        size_t run = json_string_run(&data[pos], len - pos);
+        // an escape is ASCII, so every run has to be well-formed by itself
+        if (!json_utf8_valid(&data[pos], run)) {
+            state->error = true;
+            return;
+        }
+        pos += run;
+        if (pos == len || data[pos] != '\\')
+            break;
+        pos++; // backslash
+        char decoded[4];
+        size_t used;
+        int count = json_decode_escape(&data[pos], len - pos, &used, decoded);
+        if (count <= 0 || (count == 1 && decoded[0] == '\0')) {
+            state->error = true;
+            return;
+        }
+        pos += used;
+    }
+    if (pos == len || data[pos] != '"') {
+        state->error = true;
+        return;
+    }
+    state->pos = pos + 1;
+}
+
+static void validate_number(struct json_validate_state* state) {
+    size_t span = json_number_span(&state->data[state->pos], state->len - state->pos);
+    struct json_number number;
+    int64_t integer;
+    if (span == 0 || json_parse_number(&state->data[state->pos], span, &number) != span
+        || !json_number_to_int(&number, &integer)) {
+        state->error = true;
+        return;
+    }
+    state->pos += span;
+}
+
+static void validate_open(struct json_validate_state* state, bool object) {
+    if (state->depth == state->max_depth) {
+        state->error = true;
+        return;
+    }
+    state->objects[state->depth++] = object;
+    state->pos = json_skip_ws(state->data, state->len, state->pos + 1);
+}
+
+static enum json_validate_step validate_value(struct json_validate_state* state) {
+    state->pos = json_skip_ws(state->data, state->len, state->pos);
+    if (state->pos == state->len) {
+        state->error = true;
+        return VALIDATE_DONE;
+    }
+    const char* data = state->data;
+    switch (data[state->pos]) {
+        case '{':
+            validate_open(state, true);
+            if (state->pos < state->len && data[state->pos] == '}')
+                return VALIDATE_AFTER_VALUE; // empty, closed there
+            return VALIDATE_KEY;
+        case '[':
+            validate_open(state, false);
+            if (state->pos < state->len && data[state->pos] == ']')
+                return VALIDATE_AFTER_VALUE;
+            return VALIDATE_VALUE;
+        case '"':
+            validate_string(state);
+            break;
+        case 't':
+        case 'f':
+        case 'n': {
+            size_t literal_len = json_literal_len(data[state->pos]);
+            if (state->len - state->pos < literal_len || !json_literal_matches(&data[state->pos]))
+                state->error = true;
+            state->pos += literal_len;
+            break;
+        }
+        default:
+            validate_number(state);
+    }
+    return VALIDATE_AFTER_VALUE;
+}
+
+static enum json_validate_step validate_key(struct json_validate_state* state) {
+    state->pos = json_skip_ws(state->data, state->len, state->pos);
+    if (state->pos == state->len || state->data[state->pos] != '"'
+        || ++state->keys > state->max_keys) {
+        state->error = true;
+        return VALIDATE_DONE;
+    }
+    validate_string(state);
+    if (state->error)
+        return VALIDATE_DONE;
+    state->pos = json_skip_ws(state->data, state->len, state->pos);
+    if (state->pos == state->len || state->data[state->pos] != ':') {
+        state->error = true;
+        return VALIDATE_DONE;
+    }
+    state->pos++; // :
+    return VALIDATE_VALUE;
+}
+
+// Also consumes the closing bracket of an empty container
+static enum json_validate_step validate_after_value(struct json_validate_state* state) {
+    if (state->depth == 0)
+        return VALIDATE_DONE;
+    state->pos = json_skip_ws(state->data, state->len, state->pos);
+    if (state->pos == state->len) {
+        state->error = true;
+        return VALIDATE_DONE;
+    }
+    bool in_object = state->objects[state->depth - 1];
+    char next_char = state->data[state->pos++];
+    if (next_char == ',')
+        return in_object ? VALIDATE_KEY : VALIDATE_VALUE;
+    if (next_char == (in_object ? '}' : ']')) {
+        state->depth--;
+        return VALIDATE_AFTER_VALUE;
+    }
+    state->error = true;
+    return VALIDATE_DONE;
+}
+
+bool json_validate(const char* data, size_t len, const struct json_limits* limits) {
+    struct json_validate_state state = {
+        .data = data,
+        .len = len,
+        .max_depth = JSON_MAX_DEPTH,
+        .max_keys = SIZE_MAX,
+    };
+    if (limits != NULL) {
+        if (limits->max_size != 0 && len > limits->max_size)
+            return false;
+        if (limits->max_depth != 0 && limits->max_depth < JSON_MAX_DEPTH)
+            state.max_depth = limits->max_depth;
+        if (limits->max_keys != 0)
+            state.max_keys = limits->max_keys;
+    }
+
+    enum json_validate_step step = VALIDATE_VALUE;
+    while (step != VALIDATE_DONE && !state.error) {
+        switch (step) {
+            case VALIDATE_VALUE:
+                step = validate_value(&state);
+                break;
+            case VALIDATE_KEY:
+                step = validate_key(&state);
+                break;
+            case VALIDATE_AFTER_VALUE:
+                step = validate_after_value(&state);
+                break;
+            case VALIDATE_DONE:
+                break;
+        }
+    }
+    return !state.error && json_skip_ws(data, len, state.pos) == len;
+}
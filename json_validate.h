@@ -0,0 +1,23 @@
+#ifndef JSON_VALIDATE_H_
+#define JSON_VALIDATE_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Bounds a document has to stay within, 0 for no bound
+struct json_limits {
+    // bytes of the whole document
+    size_t max_size;
+    // nesting of objects and arrays, never more than JSON_MAX_DEPTH
+    size_t max_depth;
+    // object members in the whole document
+    size_t max_keys;
+};
+
+// Checks that data holds a single document the parsers accept, within
+// limits (NULL for none but JSON_MAX_DEPTH), without building anything.
+// Nothing is allocated and every byte is looked at once, so malformed
+// input can be rejected before any parsing work is spent on it.
+bool json_validate(const char* data, size_t len, const struct json_limits* limits);
+
+#endif
@@ -0,0 +1,667 @@
+#include "json_writer.h"
+#include "json_parser.h"
+#include "json_string.h"
+#include "json_tape.h"
+#include "json_projection.h"
+#include <uk/json_ir.h>
+#include <stdbool.h>
+#include <string.h>
+
+static const char digit_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+size_t json_write_uint(char* out, uint64_t value) {
+    // two digits per division, written from the end
+    char tmp[20];
+    char* p = tmp + sizeof tmp;
+    while (value >= 100) {
+        unsigned pair = (value % 100) * 2;
+        value /= 100;
+        p -= 2;
+        memcpy(p, &digit_pairs[pair], 2);
+    }
+    if (value < 10) {
+        *--p = '0' + value;
+    } else {
+        p -= 2;
+        memcpy(p, &digit_pairs[value * 2], 2);
+    }
+    size_t len = tmp + sizeof tmp - p;
+    memcpy(out, p, len);
+    return len;
+}
+
+size_t json_write_int(char* out, int64_t value) {
+    if (value >= 0)
+        return json_write_uint(out, value);
+    out[0] = '-';
+    return 1 + json_write_uint(&out[1], 0 - (uint64_t) value);
+}
+
+/*
+ * Grisu2 by Florian Loitsch, "Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers", following the layout of Milo Yip's
+ * implementation. The output always parses back to the same double and is
+ * the shortest such string in the vast majority of cases.
+ */
+struct diy_fp {
+    uint64_t f;
+    int e;
+};
+
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS (0x3ff + DP_SIGNIFICAND_SIZE)
+#define DP_MIN_EXPONENT (-DP_EXPONENT_BIAS)
+#define DP_EXPONENT_MASK UINT64_C(0x7ff0000000000000)
+#define DP_SIGNIFICAND_MASK UINT64_C(0x000fffffffffffff)
+#define DP_HIDDEN_BIT UINT64_C(0x0010000000000000)
+
+static struct diy_fp diy_fp_from_double(double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof bits);
+    int biased_e = (bits & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE;
+    uint64_t significand = bits & DP_SIGNIFICAND_MASK;
+    struct diy_fp fp;
+    if (biased_e != 0) {
+        fp.f = significand + DP_HIDDEN_BIT;
+        fp.e = biased_e - DP_EXPONENT_BIAS;
+    } else {
+        fp.f = significand;
+        fp.e = DP_MIN_EXPONENT + 1;
+    }
+    return fp;
+}
+
+static struct diy_fp diy_fp_mul(struct diy_fp a, struct diy_fp b) {
+    struct diy_fp r;
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 p = (unsigned __int128) a.f * b.f;
+    uint64_t h = p >> 64;
+    uint64_t l = (uint64_t) p;
+    if (l & (UINT64_C(1) << 63)) // rounding
+        h++;
+    r.f = h;
+#else
+    const uint64_t mask = 0xffffffff;
+    uint64_t a_hi = a.f >> 32, a_lo = a.f & mask;
+    uint64_t b_hi = b.f >> 32, b_lo = b.f & mask;
+    uint64_t ac = a_hi * b_hi, bc = a_lo * b_hi;
+    uint64_t ad = a_hi * b_lo, bd = a_lo * b_lo;
+    uint64_t tmp = (bd >> 32) + (ad & mask) + (bc & mask);
+    tmp += UINT64_C(1) << 31; // rounding
+    r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+#endif
+    r.e = a.e + b.e + 64;
+    return r;
+}
+
+static struct diy_fp diy_fp_normalize(struct diy_fp fp) {
+    int s = __builtin_clzll(fp.f);
+    fp.f <<= s;
+    fp.e -= s;
+    return fp;
+}
+
+static void normalized_boundaries(struct diy_fp v, struct diy_fp* minus, struct diy_fp* plus) {
+    struct diy_fp pl = { (v.f << 1) + 1, v.e - 1 };
+    while (!(pl.f & (DP_HIDDEN_BIT << 1))) {
+        pl.f <<= 1;
+        pl.e--;
+    }
+    pl.f <<= 64 - DP_SIGNIFICAND_SIZE - 2;
+    pl.e -= 64 - DP_SIGNIFICAND_SIZE - 2;
+    struct diy_fp mi;
+    if (v.f == DP_HIDDEN_BIT) {
+        mi.f = (v.f << 2) - 1;
+        mi.e = v.e - 2;
+    } else {
+        mi.f = (v.f << 1) - 1;
+        mi.e = v.e - 1;
+    }
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+    *plus = pl;
+    *minus = mi;
+}
+
+// 10^-348, 10^-340, ..., 10^340 as normalized 64-bit mantissa (rounded)
+// and binary exponent
+static const struct diy_fp cached_powers[] = {
+    { UINT64_C(0xfa8fd5a0081c0288), -1220 }, // 1e-348
+    { UINT64_C(0xbaaee17fa23ebf76), -1193 }, // 1e-340
+    { UINT64_C(0x8b16fb203055ac76), -1166 }, // 1e-332
+    { UINT64_C(0xcf42894a5dce35ea), -1140 }, // 1e-324
+    { UINT64_C(0x9a6bb0aa55653b2d), -1113 }, // 1e-316
+    { UINT64_C(0xe61acf033d1a45df), -1087 }, // 1e-308
+    { UINT64_C(0xab70fe17c79ac6ca), -1060 }, // 1e-300
+    { UINT64_C(0xff77b1fcbebcdc4f), -1034 }, // 1e-292
+    { UINT64_C(0xbe5691ef416bd60c), -1007 }, // 1e-284
+    { UINT64_C(0x8dd01fad907ffc3c), -980 }, // 1e-276
+    { UINT64_C(0xd3515c2831559a83), -954 }, // 1e-268
+    { UINT64_C(0x9d71ac8fada6c9b5), -927 }, // 1e-260
+    { UINT64_C(0xea9c227723ee8bcb), -901 }, // 1e-252
+    { UINT64_C(0xaecc49914078536d), -874 }, // 1e-244
+    { UINT64_C(0x823c12795db6ce57), -847 }, // 1e-236
+    { UINT64_C(0xc21094364dfb5637), -821 }, // 1e-228
+    { UINT64_C(0x9096ea6f3848984f), -794 }, // 1e-220
+    { UINT64_C(0xd77485cb25823ac7), -768 }, // 1e-212
+    { UINT64_C(0xa086cfcd97bf97f4), -741 }, // 1e-204
+    { UINT64_C(0xef340a98172aace5), -715 }, // 1e-196
+    { UINT64_C(0xb23867fb2a35b28e), -688 }, // 1e-188
+    { UINT64_C(0x84c8d4dfd2c63f3b), -661 }, // 1e-180
+    { UINT64_C(0xc5dd44271ad3cdba), -635 }, // 1e-172
+    { UINT64_C(0x936b9fcebb25c996), -608 }, // 1e-164
+    { UINT64_C(0xdbac6c247d62a584), -582 }, // 1e-156
+    { UINT64_C(0xa3ab66580d5fdaf6), -555 }, // 1e-148
+    { UINT64_C(0xf3e2f893dec3f126), -529 }, // 1e-140
+    { UINT64_C(0xb5b5ada8aaff80b8), -502 }, // 1e-132
+    { UINT64_C(0x87625f056c7c4a8b), -475 }, // 1e-124
+    { UINT64_C(0xc9bcff6034c13053), -449 }, // 1e-116
+    { UINT64_C(0x964e858c91ba2655), -422 }, // 1e-108
+    { UINT64_C(0xdff9772470297ebd), -396 }, // 1e-100
+    { UINT64_C(0xa6dfbd9fb8e5b88f), -369 }, // 1e-92
+    { UINT64_C(0xf8a95fcf88747d94), -343 }, // 1e-84
+    { UINT64_C(0xb94470938fa89bcf), -316 }, // 1e-76
+    { UINT64_C(0x8a08f0f8bf0f156b), -289 }, // 1e-68
+    { UINT64_C(0xcdb02555653131b6), -263 }, // 1e-60
+    { UINT64_C(0x993fe2c6d07b7fac), -236 }, // 1e-52
+    { UINT64_C(0xe45c10c42a2b3b06), -210 }, // 1e-44
+    { UINT64_C(0xaa242499697392d3), -183 }, // 1e-36
+    { UINT64_C(0xfd87b5f28300ca0e), -157 }, // 1e-28
+    { UINT64_C(0xbce5086492111aeb), -130 }, // 1e-20
+    { UINT64_C(0x8cbccc096f5088cc), -103 }, // 1e-12
+    { UINT64_C(0xd1b71758e219652c), -77 }, // 1e-4
+    { UINT64_C(0x9c40000000000000), -50 }, // 1e4
+    { UINT64_C(0xe8d4a51000000000), -24 }, // 1e12
+    { UINT64_C(0xad78ebc5ac620000), 3 }, // 1e20
+    { UINT64_C(0x813f3978f8940984), 30 }, // 1e28
+    { UINT64_C(0xc097ce7bc90715b3), 56 }, // 1e36
+    { UINT64_C(0x8f7e32ce7bea5c70), 83 }, // 1e44
+    { UINT64_C(0xd5d238a4abe98068), 109 }, // 1e52
+    { UINT64_C(0x9f4f2726179a2245), 136 }, // 1e60
+    { UINT64_C(0xed63a231d4c4fb27), 162 }, // 1e68
+    { UINT64_C(0xb0de65388cc8ada8), 189 }, // 1e76
+    { UINT64_C(0x83c7088e1aab65db), 216 }, // 1e84
+    { UINT64_C(0xc45d1df942711d9a), 242 }, // 1e92
+    { UINT64_C(0x924d692ca61be758), 269 }, // 1e100
+    { UINT64_C(0xda01ee641a708dea), 295 }, // 1e108
+    { UINT64_C(0xa26da3999aef774a), 322 }, // 1e116
+    { UINT64_C(0xf209787bb47d6b85), 348 }, // 1e124
+    { UINT64_C(0xb454e4a179dd1877), 375 }, // 1e132
+    { UINT64_C(0x865b86925b9bc5c2), 402 }, // 1e140
+    { UINT64_C(0xc83553c5c8965d3d), 428 }, // 1e148
+    { UINT64_C(0x952ab45cfa97a0b3), 455 }, // 1e156
+    { UINT64_C(0xde469fbd99a05fe3), 481 }, // 1e164
+    { UINT64_C(0xa59bc234db398c25), 508 }, // 1e172
+    { UINT64_C(0xf6c69a72a3989f5c), 534 }, // 1e180
+    { UINT64_C(0xb7dcbf5354e9bece), 561 }, // 1e188
+    { UINT64_C(0x88fcf317f22241e2), 588 }, // 1e196
+    { UINT64_C(0xcc20ce9bd35c78a5), 614 }, // 1e204
+    { UINT64_C(0x98165af37b2153df), 641 }, // 1e212
+    { UINT64_C(0xe2a0b5dc971f303a), 667 }, // 1e220
+    { UINT64_C(0xa8d9d1535ce3b396), 694 }, // 1e228
+    { UINT64_C(0xfb9b7cd9a4a7443c), 720 }, // 1e236
+    { UINT64_C(0xbb764c4ca7a44410), 747 }, // 1e244
+    { UINT64_C(0x8bab8eefb6409c1a), 774 }, // 1e252
+    { UINT64_C(0xd01fef10a657842c), 800 }, // 1e260
+    { UINT64_C(0x9b10a4e5e9913129), 827 }, // 1e268
+    { UINT64_C(0xe7109bfba19c0c9d), 853 }, // 1e276
+    { UINT64_C(0xac2820d9623bf429), 880 }, // 1e284
+    { UINT64_C(0x80444b5e7aa7cf85), 907 }, // 1e292
+    { UINT64_C(0xbf21e44003acdd2d), 933 }, // 1e300
+    { UINT64_C(0x8e679c2f5e44ff8f), 960 }, // 1e308
+    { UINT64_C(0xd433179d9c8cb841), 986 }, // 1e316
+    { UINT64_C(0x9e19db92b4e31ba9), 1013 }, // 1e324
+    { UINT64_C(0xeb96bf6ebadf77d9), 1039 }, // 1e332
+    { UINT64_C(0xaf87023b9bf0ee6b), 1066 }, // 1e340
+};
+
+static struct diy_fp get_cached_power(int e, int* k) {
+    double dk = (-61 - e) * 0.30102999566398114 + 347; // dk must be positive
+    int ik = (int) dk;
+    if (dk - ik > 0.0)
+        ik++;
+    unsigned index = (ik >> 3) + 1;
+    *k = -(-348 + (int) (index << 3)); // decimal exponent of the cached power
+    return cached_powers[index];
+}
+
+static const uint64_t pow10_u64[] = {
+    UINT64_C(1), UINT64_C(10), UINT64_C(100), UINT64_C(1000), UINT64_C(10000),
+    UINT64_C(100000), UINT64_C(1000000), UINT64_C(10000000), UINT64_C(100000000),
+    UINT64_C(1000000000), UINT64_C(10000000000), UINT64_C(100000000000),
+    UINT64_C(1000000000000), UINT64_C(10000000000000), UINT64_C(100000000000000),
+    UINT64_C(1000000000000000), UINT64_C(10000000000000000),
+    UINT64_C(100000000000000000), UINT64_C(1000000000000000000),
+    UINT64_C(10000000000000000000),
+};
+
+static void grisu_round(char* buffer, int len, uint64_t delta, uint64_t rest,
+                        uint64_t ten_kappa, uint64_t wp_w) {
+    while (rest < wp_w && delta - rest >= ten_kappa
+           && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static int count_decimal_digits(uint32_t n) {
+    int digits = 1;
+    while (digits < 10 && n >= pow10_u64[digits])
+        digits++;
+    return digits;
+}
+
+static void digit_gen(struct diy_fp w, struct diy_fp mp, uint64_t delta, char* buffer, int* len, int* k) {
+    struct diy_fp one = { UINT64_C(1) << -mp.e, mp.e };
+    uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t) (mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = count_decimal_digits(p1);
+    *len = 0;
+
+    while (kappa > 0) {
+        uint32_t d = p1 / pow10_u64[kappa - 1];
+        p1 %= pow10_u64[kappa - 1];
+        if (d || *len)
+            buffer[(*len)++] = '0' + d;
+        kappa--;
+        uint64_t tmp = ((uint64_t) p1 << -one.e) + p2;
+        if (tmp <= delta) {
+            *k += kappa;
+            grisu_round(buffer, *len, delta, tmp, pow10_u64[kappa] << -one.e, wp_w);
+            return;
+        }
+    }
+
+    // kappa = 0
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char) (p2 >> -one.e);
+        if (d || *len)
+            buffer[(*len)++] = '0' + d;
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *k += kappa;
+            int index = -kappa;
+            grisu_round(buffer, *len, delta, p2, one.f, wp_w * (index < 20 ? pow10_u64[index] : 0));
+            return;
+        }
+    }
+}
+
+static void grisu2(double value, char* buffer, int* len, int* k) {
+    struct diy_fp v = diy_fp_from_double(value);
+    struct diy_fp w_m, w_p;
+    normalized_boundaries(v, &w_m, &w_p);
+
+    struct diy_fp c_mk = get_cached_power(w_p.e, k);
+    struct diy_fp w = diy_fp_mul(diy_fp_normalize(v), c_mk);
+    struct diy_fp wp = diy_fp_mul(w_p, c_mk);
+    struct diy_fp wm = diy_fp_mul(w_m, c_mk);
+    wm.f++;
+    wp.f--;
+    digit_gen(w, wp, wp.f - wm.f, buffer, len, k);
+}
+
+static char* write_exponent(int k, char* buffer) {
+    if (k < 0) {
+        *buffer++ = '-';
+        k = -k;
+    }
+    if (k >= 100) {
+        *buffer++ = '0' + k / 100;
+        k %= 100;
+        memcpy(buffer, &digit_pairs[k * 2], 2);
+        buffer += 2;
+    } else if (k >= 10) {
+        memcpy(buffer, &digit_pairs[k * 2], 2);
+        buffer += 2;
+    } else {
+        *buffer++ = '0' + k;
+    }
+    return buffer;
+}
+
+// Places the decimal point in the len digits of buffer worth digits * 10^k
+static char* prettify(char* buffer, int len, int k) {
+    int kk = len + k; // 10^(kk-1) <= v < 10^kk
+    if (k >= 0 && kk <= 21) {
+        // 1234e7 -> 12340000000.0
+        for (int i = len; i < kk; i++)
+            buffer[i] = '0';
+        buffer[kk] = '.';
+        buffer[kk + 1] = '0';
+        return &buffer[kk + 2];
+    }
+    if (kk > 0 && kk <= 21) {
+        // 1234e-2 -> 12.34
+        memmove(&buffer[kk + 1], &buffer[kk], len - kk);
+        buffer[kk] = '.';
+        return &buffer[len + 1];
+    }
+    if (kk > -6 && kk <= 0) {
+        // 1234e-6 -> 0.001234
+        int offset = 2 - kk;
+        memmove(&buffer[offset], &buffer[0], len);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        for (int i = 2; i < offset; i++)
+            buffer[i] = '0';
+        return &buffer[len + offset];
+    }
+    if (len == 1) {
+        // 1e30
+        buffer[1] = 'e';
+        return write_exponent(kk - 1, &buffer[2]);
+    }
+    // 1234e30 -> 1.234e33
+    memmove(&buffer[2], &buffer[1], len - 1);
+    buffer[1] = '.';
+    buffer[len + 1] = 'e';
+    return write_exponent(kk - 1, &buffer[len + 2]);
+}
+
+size_t json_write_double(char* out, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof bits);
+    if ((bits & DP_EXPONENT_MASK) == DP_EXPONENT_MASK) {
+        memcpy(out, "null", 4);
+        return 4;
+    }
+    char* p = out;
+    if (bits >> 63) {
+        *p++ = '-';
+        value = -value;
+    }
+    if (value == 0) {
+        memcpy(p, "0.0", 3);
+        return p + 3 - out;
+    }
+    int len, k;
+    grisu2(value, p, &len, &k);
+    return prettify(p, len, k) - out;
+}
+
+struct json_writer {
+    char* buff;
+    size_t len;
+    size_t pos;
+};
+
+static void put(struct json_writer* writer, const char* data, size_t len) {
+    if (writer->pos < writer->len) {
+        size_t room = writer->len - writer->pos;
+        memcpy(&writer->buff[writer->pos], data, len < room ? len : room);
+    }
+    writer->pos += len;
+}
+
+static void put_char(struct json_writer* writer, char c) {
+    if (writer->pos < writer->len)
+        writer->buff[writer->pos] = c;
+    writer->pos++;
+}
+
+static void put_string(struct json_writer* writer, const char* string, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    put_char(writer, '"');
+    while (len > 0) {
+        // plain runs are copied as a block
+        size_t run = json_string_run(string, len);
+        put(writer, string, run);
+        string += run;
+        len -= run;
+        if (len == 0)
+            break;
+        unsigned char c = *string++;
+        len--;
+        char escape[6] = { '\\', c, 0 };
+        size_t escape_len = 2;
+        switch (c) {
+            case '"':
+            case '\\':
+                break;
+            case '\b':
+                escape[1] = 'b';
+                break;
+            case '\f':
+                escape[1] = 'f';
+                break;
+            case '\n':
+                escape[1] = 'n';
+                break;
+            case '\r':
+                escape[1] = 'r';
+                break;
+            case '\t':
+                escape[1] = 't';
+                break;
+            default:
+                memcpy(escape, "\\u00", 4);
+                escape[4] = hex[c >> 4];
+                escape[5] = hex[c & 0xf];
+                escape_len = 6;
+        }
+        put(writer, escape, escape_len);
+    }
+    put_char(writer, '"');
+}
+
+static void put_int(struct json_writer* writer, int64_t value) {
+    if (writer->pos + JSON_NUMBER_CHARS <= writer->len) {
+        writer->pos += json_write_int(&writer->buff[writer->pos], value);
+        return;
+    }
+    char tmp[JSON_NUMBER_CHARS];
+    put(writer, tmp, json_write_int(tmp, value));
+}
+
+// Output trees come from the diag functions, not from clients, so plain
+// recursion is fine here. Only the members fields selects are written, all
+// of them if it is NULL.
+static void put_value(struct json_writer* writer, const struct json_value* value,
+                      const struct json_projection* fields) {
+    if (value == NULL) {
+        put(writer, "null", 4);
+        return;
+    }
+    switch (value->type) {
+        case JSON_NULL:
+            put(writer, "null", 4);
+            break;
+        case JSON_TRUE:
+            put(writer, "true", 4);
+            break;
+        case JSON_FALSE:
+            put(writer, "false", 5);
+            break;
+        case JSON_INT:
+            put_int(writer, value->integer);
+            break;
+        case JSON_STRING:
+            put_string(writer, value->string, strlen(value->string));
+            break;
+        case JSON_ARRAY:
+            put_char(writer, '[');
+            for (size_t i = 0; i < value->array->size; i++) {
+                if (i > 0)
+                    put_char(writer, ',');
+                put_value(writer, value->array->values[i], fields);
+            }
+            put_char(writer, ']');
+            break;
+        case JSON_OBJECT: {
+            bool first = true;
+            put_char(writer, '{');
+            for (struct json_object* obj = value->object; obj != NULL; obj = obj->next) {
+                const struct json_projection* field = NULL;
+                if (fields != NULL && (field = json_projection_find(fields, obj->key)) == NULL)
+                    continue;
+                if (!first)
+                    put_char(writer, ',');
+                first = false;
+                put_string(writer, obj->key, strlen(obj->key));
+                put_char(writer, ':');
+                put_value(writer, obj->value, field != NULL ? field->fields : NULL);
+            }
+            put_char(writer, '}');
+            break;
+        }
+        default:
+            put(writer, "null", 4);
+    }
+}
+
+static size_t measure_uint(uint64_t value) {
+    size_t len = 1;
+    while (value >= 100) {
+        value /= 100;
+        len += 2;
+    }
+    return len + (value >= 10);
+}
+
+static size_t measure_string(const char* string) {
+    size_t left = strlen(string);
+    size_t len = 2 + left;
+    while (left > 0) {
+        size_t run = json_string_run(string, left);
+        string += run;
+        left -= run;
+        if (left == 0)
+            break;
+        unsigned char c = *string++;
+        left--;
+        // the escape replaces the character itself
+        if (c == '"' || c == '\\' || c == '\b' || c == '\f' || c == '\n' || c == '\r' || c == '\t')
+            len += 1;
+        else
+            len += 5;
+    }
+    return len;
+}
+
+size_t json_measure_projected(const struct json_value* value,
+                              const struct json_projection* fields) {
+    if (value == NULL)
+        return 4;
+    size_t len;
+    switch (value->type) {
+        case JSON_FALSE:
+            return 5;
+        case JSON_INT:
+            if (value->integer < 0)
+                return 1 + measure_uint(0 - (uint64_t) value->integer);
+            return measure_uint(value->integer);
+        case JSON_STRING:
+            return measure_string(value->string);
+        case JSON_ARRAY:
+            // brackets and separators
+            len = value->array->size > 0 ? value->array->size + 1 : 2;
+            for (size_t i = 0; i < value->array->size; i++)
+                len += json_measure_projected(value->array->values[i], fields);
+            return len;
+        case JSON_OBJECT:
+            // braces, and a separator ahead of every member, less one
+            len = 1;
+            for (struct json_object* obj = value->object; obj != NULL; obj = obj->next) {
+                const struct json_projection* field = NULL;
+                if (fields != NULL && (field = json_projection_find(fields, obj->key)) == NULL)
+                    continue;
+                len += 1 + measure_string(obj->key) + 1
+                       + json_measure_projected(obj->value, field != NULL ? field->fields : NULL);
+            }
+            return len > 1 ? len : 2;
+        default:
+            // null, true and everything written as null
+            return 4;
+    }
+}
+
+static size_t finish(struct json_writer* writer) {
+    if (writer->pos < writer->len)
+        writer->buff[writer->pos] = '\0';
+    else if (writer->len > 0)
+        writer->buff[writer->len - 1] = '\0';
+    return writer->pos;
+}
+
+size_t json_measure(const struct json_value* value) {
+    return json_measure_projected(value, NULL);
+}
+
+size_t json_serialize(char* buff, size_t buff_len, const struct json_value* value) {
+    return json_serialize_projected(buff, buff_len, value, NULL);
+}
+
+size_t json_serialize_projected(char* buff, size_t buff_len, const struct json_value* value,
+                                const struct json_projection* fields) {
+    struct json_writer writer = { buff, buff_len, 0 };
+    put_value(&writer, value, fields);
+    return finish(&writer);
+}
+
+size_t json_tape_serialize(char* buff, size_t buff_len, const struct json_tape* tape, size_t idx) {
+    struct json_writer writer = { buff, buff_len, 0 };
+    char tmp[JSON_NUMBER_CHARS];
+    size_t end = json_tape_next(tape, idx);
+    // number of items written so far in each open container, object keys
+    // and values counting separately
+    size_t items[JSON_MAX_DEPTH + 1];
+    bool object[JSON_MAX_DEPTH + 1];
+    size_t depth = 0;
+    while (idx < end) {
+        enum json_tape_type type = json_tape_type(tape, idx);
+        if (type == JSON_TAPE_OBJECT_END || type == JSON_TAPE_ARRAY_END) {
+            put_char(&writer, type);
+            depth--;
+            idx++;
+            continue;
+        }
+        if (depth > 0 && items[depth]++ > 0)
+            put_char(&writer, object[depth] && items[depth] % 2 == 0 ? ':' : ',');
+
+        size_t len;
+        const char* string;
+        switch (type) {
+            case JSON_TAPE_OBJECT:
+            case JSON_TAPE_ARRAY:
+                put_char(&writer, type);
+                depth++;
+                items[depth] = 0;
+                object[depth] = type == JSON_TAPE_OBJECT;
+                idx++;
+                continue;
+            case JSON_TAPE_STRING:
+                string = json_tape_string(tape, idx, &len);
+                put_string(&writer, string, len);
+                break;
+            case JSON_TAPE_INT:
+                put(&writer, tmp, json_write_int(tmp, json_tape_int(tape, idx)));
+                break;
+            case JSON_TAPE_UINT:
+                put(&writer, tmp, json_write_uint(tmp, json_tape_uint(tape, idx)));
+                break;
+            case JSON_TAPE_DOUBLE:
+                put(&writer, tmp, json_write_double(tmp, json_tape_double(tape, idx)));
+                break;
+            case JSON_TAPE_TRUE:
+                put(&writer, "true", 4);
+                break;
+            case JSON_TAPE_FALSE:
+                put(&writer, "false", 5);
+                break;
+            default:
+                put(&writer, "null", 4);
+        }
+        idx = json_tape_next(tape, idx);
+    }
+    return finish(&writer);
+}
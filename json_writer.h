@@ -0,0 +1,39 @@
+#ifndef JSON_WRITER_H_
+#define JSON_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Space the number formatters below may write
+#define JSON_NUMBER_CHARS 32
+
+struct json_value;
+struct json_tape;
+struct json_projection;
+
+// Number formatters, they write at most JSON_NUMBER_CHARS bytes to out
+// (not '\0' terminated) and return the number of bytes written.
+size_t json_write_int(char* out, int64_t value);
+size_t json_write_uint(char* out, uint64_t value);
+// Shortest representation that parses back to the same double (Grisu2).
+// NaN and infinities have no JSON representation and are written as null.
+size_t json_write_double(char* out, double value);
+
+// Serializes value into buff like snprintf(): at most buff_len bytes are
+// written, '\0' terminated if there is room, and the length of the full
+// serialization is returned. Strings are escaped as needed.
+size_t json_serialize(char* buff, size_t buff_len, const struct json_value* value);
+// Exact length json_serialize() produces for value, without the '\0'.
+// Nothing is formatted, so sizing a buffer this way costs a fraction of
+// serializing twice.
+size_t json_measure(const struct json_value* value);
+// Same for the members of value that fields selects, see json_projection.h.
+// The others are skipped without being formatted or measured.
+size_t json_serialize_projected(char* buff, size_t buff_len, const struct json_value* value,
+                                const struct json_projection* fields);
+size_t json_measure_projected(const struct json_value* value,
+                              const struct json_projection* fields);
+// Same for the value starting at idx of a tape
+size_t json_tape_serialize(char* buff, size_t buff_len, const struct json_tape* tape, size_t idx);
+
+#endif
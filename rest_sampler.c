@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <uk/config.h>
+#include <uk/plat/time.h>
+#include <uk/sched.h>
+#include <uk/thread.h>
+#include <uk/json_ir.h>
+#include "rest_sampler.h"
+#include "json_arena.h"
+#include "json_writer.h"
+
+#define MAX_SERIES CONFIG_LIBUKDIAGREST_SAMPLER_SERIES
+#define SAMPLES CONFIG_LIBUKDIAGREST_SAMPLER_SAMPLES
+#define SAMPLER_MEMORY CONFIG_LIBUKDIAGREST_SAMPLER_MEMORY
+
+#define NSEC_PER_MS 1000000ULL
+/* Longest the thread sleeps, functions set over REST start within it */
+#define IDLE_NSEC (100 * NSEC_PER_MS)
+
+struct sampled_function {
+    char name[SAMPLER_NAME_MAX];
+    /* 0 if it is not sampled any more */
+    __nsec interval;
+    __nsec due;
+};
+
+struct sample {
+    uint64_t time_ms;
+    int64_t value;
+};
+
+struct series {
+    const struct sampled_function* function;
+    char path[SAMPLER_PATH_MAX];
+    /* ring buffer: the oldest sample and the number of samples */
+    size_t start;
+    size_t count;
+    struct sample samples[SAMPLES];
+};
+
+static struct sampled_function functions[SAMPLER_FUNCTIONS];
+static size_t function_count;
+static struct series series[MAX_SERIES];
+static size_t series_count;
+
+/* Outputs allocated with rest_request_alloc(), reset after every sample */
+static char sampler_memory[SAMPLER_MEMORY];
+static struct json_arena sampler_arena;
+static rest_sampler_run_t sampler_run;
+
+/* A slot whose function was stopped before any of it was recorded */
+static bool slot_free(const struct sampled_function* function)
+{
+    return function->name[0] == '\0';
+}
+
+static struct sampled_function* find_in(struct sampled_function* table, size_t count,
+                                        const char* name, size_t name_len)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (!slot_free(&table[i]) && strncmp(table[i].name, name, name_len) == 0
+            && table[i].name[name_len] == '\0')
+            return &table[i];
+    }
+    return NULL;
+}
+
+static struct sampled_function* find_sampled(const char* name, size_t name_len)
+{
+    return find_in(functions, function_count, name, name_len);
+}
+
+/* Whether the function in slot i of the table has recorded series */
+static bool has_series(size_t i)
+{
+    for (size_t n = 0; n < series_count; n++) {
+        if (series[n].function == &functions[i])
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Sets a function in table, a copy of functions with *count slots in use.
+ * Stopping a function frees its slot unless it has series, and stopping
+ * one that is not sampled does nothing.
+ */
+static int set_in(struct sampled_function* table, size_t* count,
+                  const char* name, size_t name_len, uint64_t interval_ms)
+{
+    if (name_len == 0 || name_len >= SAMPLER_NAME_MAX)
+        return -1;
+    struct sampled_function* function = find_in(table, *count, name, name_len);
+    if (function == NULL && interval_ms == 0)
+        return 0;
+    if (function == NULL) {
+        for (size_t i = 0; i < *count && function == NULL; i++) {
+            if (slot_free(&table[i]))
+                function = &table[i];
+        }
+        if (function == NULL && *count == SAMPLER_FUNCTIONS)
+            return -1;
+        if (function == NULL)
+            function = &table[(*count)++];
+        memcpy(function->name, name, name_len);
+        function->name[name_len] = '\0';
+    }
+    function->interval = interval_ms * NSEC_PER_MS;
+    /* sampled on the next round */
+    function->due = 0;
+    if (interval_ms == 0 && !has_series(function - table))
+        function->name[0] = '\0';
+    return 0;
+}
+
+int rest_sampler_update(const struct json_value* settings)
+{
+    /* applied to a copy, so a failed update leaves the table as it was */
+    struct sampled_function table[SAMPLER_FUNCTIONS];
+    size_t count = function_count;
+    memcpy(table, functions, sizeof table);
+    for (const struct json_object* obj = settings->object; obj != NULL; obj = obj->next) {
+        if (set_in(table, &count, obj->key, strlen(obj->key), obj->value->integer) != 0)
+            return -1;
+    }
+    memcpy(functions, table, sizeof table);
+    function_count = count;
+    return 0;
+}
+
+static void record(const struct sampled_function* function, const char* path,
+                   uint64_t time_ms, int64_t value)
+{
+    struct series* s = NULL;
+    for (size_t i = 0; i < series_count && s == NULL; i++) {
+        if (series[i].function == function && strcmp(series[i].path, path) == 0)
+            s = &series[i];
+    }
+    if (s == NULL) {
+        if (series_count == MAX_SERIES)
+            return;
+        s = &series[series_count++];
+        s->function = function;
+        strcpy(s->path, path);
+        s->start = 0;
+        s->count = 0;
+    }
+    struct sample* sample = &s->samples[(s->start + s->count) % SAMPLES];
+    if (s->count == SAMPLES)
+        s->start = (s->start + 1) % SAMPLES;
+    else
+        s->count++;
+    sample->time_ms = time_ms;
+    sample->value = value;
+}
+
+/* Records the integers of value, whose path takes the first len bytes of path */
+static void record_leaves(const struct sampled_function* function,
+                          const struct json_value* value, char* path, size_t len,
+                          uint64_t time_ms)
+{
+    if (value == NULL)
+        return;
+    const char* separator = len > 0 ? "/" : "";
+    int added;
+    switch (value->type) {
+        case JSON_INT:
+            path[len] = '\0';
+            record(function, path, time_ms, value->integer);
+            break;
+        case JSON_ARRAY:
+            for (size_t i = 0; i < value->array->size; i++) {
+                added = snprintf(&path[len], SAMPLER_PATH_MAX - len, "%s%zu", separator, i);
+                if (added > 0 && (size_t) added < SAMPLER_PATH_MAX - len)
+                    record_leaves(function, value->array->values[i], path, len + added, time_ms);
+            }
+            break;
+        case JSON_OBJECT:
+            for (const struct json_object* obj = value->object; obj != NULL; obj = obj->next) {
+                added = snprintf(&path[len], SAMPLER_PATH_MAX - len, "%s%s", separator, obj->key);
+                if (added > 0 && (size_t) added < SAMPLER_PATH_MAX - len)
+                    record_leaves(function, obj->value, path, len + added, time_ms);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void sample(const struct sampled_function* function, __nsec now)
+{
+    struct json_value* output = sampler_run(function->name, &sampler_arena);
+    char path[SAMPLER_PATH_MAX];
+    record_leaves(function, output, path, 0, now / NSEC_PER_MS);
+    if (output != NULL && !json_arena_owns(&sampler_arena, output))
+        free_json_value(output);
+    json_arena_reset(&sampler_arena);
+}
+
+static void sampler_thread(void* arg)
+{
+    (void) arg;
+    for (;;) {
+        __nsec now = ukplat_monotonic_clock();
+        __nsec wake = now + IDLE_NSEC;
+        for (size_t i = 0; i < function_count; i++) {
+            struct sampled_function* function = &functions[i];
+            if (function->interval == 0)
+                continue;
+            if (function->due <= now) {
+                sample(function, now);
+                /* a late sample does not bring the next ones forward */
+                function->due += function->interval;
+                if (function->due <= now)
+                    function->due = now + function->interval;
+            }
+            if (function->due < wake)
+                wake = function->due;
+        }
+        now = ukplat_monotonic_clock();
+        if (wake > now)
+            uk_sched_thread_sleep(wake - now);
+    }
+}
+
+/* Sets the functions of a "name:ms,name:ms" list */
+static void set_functions(const char* list)
+{
+    while (*list != '\0') {
+        size_t len = strcspn(list, ",");
+        const char* colon = memchr(list, ':', len);
+        uint64_t interval_ms = 0;
+        bool valid = colon != NULL && colon > list && colon + 1 < list + len;
+        for (const char* c = valid ? colon + 1 : list + len; c < list + len && valid; c++) {
+            valid = *c >= '0' && *c <= '9';
+            interval_ms = interval_ms * 10 + *c - '0';
+        }
+        if (!valid || set_in(functions, &function_count, list, colon - list, interval_ms) != 0)
+            fprintf(stderr, "Cannot sample %.*s\n", (int) len, list);
+        list += len;
+        if (*list == ',')
+            list++;
+    }
+}
+
+int rest_sampler_start(rest_sampler_run_t run)
+{
+    sampler_run = run;
+    json_arena_init(&sampler_arena, sampler_memory, SAMPLER_MEMORY);
+    set_functions(CONFIG_LIBUKDIAGREST_SAMPLER_FUNCTIONS);
+    if (uk_thread_create("ukdiagrest-sampler", sampler_thread, NULL) == NULL) {
+        fprintf(stderr, "Failed to create the sampler thread\n");
+        return -1;
+    }
+    return 0;
+}
+
+struct sampler_output {
+    char* buff;
+    size_t len;
+    size_t pos;
+};
+
+static void put(struct sampler_output* out, const char* data, size_t len)
+{
+    if (out->pos < out->len) {
+        size_t room = out->len - out->pos;
+        memcpy(&out->buff[out->pos], data, len < room ? len : room);
+    }
+    out->pos += len;
+}
+
+static void put_int(struct sampler_output* out, int64_t value)
+{
+    char tmp[JSON_NUMBER_CHARS];
+    put(out, tmp, json_write_int(tmp, value));
+}
+
+/* Writes string as a key, escaped as needed */
+static void put_key(struct sampler_output* out, const char* key)
+{
+    struct json_value string = { .type = JSON_STRING, .string = (char*) key };
+    if (out->pos < out->len)
+        out->pos += json_serialize(&out->buff[out->pos], out->len - out->pos, &string);
+    else
+        out->pos += json_measure(&string);
+    put(out, ":", 1);
+}
+
+static size_t finish(struct sampler_output* out)
+{
+    if (out->pos < out->len)
+        out->buff[out->pos] = '\0';
+    else if (out->len > 0)
+        out->buff[out->len - 1] = '\0';
+    return out->pos;
+}
+
+size_t rest_sampler_config(char* buff, size_t buff_len)
+{
+    struct sampler_output out = { buff, buff_len, 0 };
+    bool first = true;
+    put(&out, "{", 1);
+    for (size_t i = 0; i < function_count; i++) {
+        if (slot_free(&functions[i]))
+            continue;
+        if (!first)
+            put(&out, ",", 1);
+        first = false;
+        put_key(&out, functions[i].name);
+        put_int(&out, functions[i].interval / NSEC_PER_MS);
+    }
+    put(&out, "}", 1);
+    return finish(&out);
+}
+
+size_t rest_sampler_samples(char* buff, size_t buff_len, const char* name,
+                            size_t name_len, uint64_t from_ms, uint64_t to_ms)
+{
+    const struct sampled_function* function = find_sampled(name, name_len);
+    if (function == NULL)
+        return SIZE_MAX;
+
+    struct sampler_output out = { buff, buff_len, 0 };
+    bool first = true;
+    put(&out, "{", 1);
+    for (size_t i = 0; i < series_count; i++) {
+        const struct series* s = &series[i];
+        if (s->function != function)
+            continue;
+        if (!first)
+            put(&out, ",", 1);
+        first = false;
+        put_key(&out, s->path);
+        put(&out, "[", 1);
+        bool first_sample = true;
+        for (size_t n = 0; n < s->count; n++) {
+            const struct sample* sample = &s->samples[(s->start + n) % SAMPLES];
+            if (sample->time_ms < from_ms || sample->time_ms > to_ms)
+                continue;
+            put(&out, first_sample ? "[" : ",[", first_sample ? 1 : 2);
+            first_sample = false;
+            put_int(&out, sample->time_ms);
+            put(&out, ",", 1);
+            put_int(&out, sample->value);
+            put(&out, "]", 1);
+        }
+        put(&out, "]", 1);
+    }
+    put(&out, "}", 1);
+    return finish(&out);
+}
@@ -0,0 +1,62 @@
+#ifndef REST_SAMPLER_H_
+#define REST_SAMPLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Periodic sampler. A background thread runs the sampled functions at
+ * their intervals and appends every integer of their outputs to the ring
+ * buffer of its series, named by its path in the output: "free",
+ * "threads/0/cpu". All of its memory is static; once the table of series
+ * is full, new leaves are not recorded.
+ *
+ * The sampler shares the diag functions and the lookup indexes with the
+ * server thread, but not the pools or the intern table: outputs come from
+ * its own arena, and functions are found by name. This relies on the
+ * cooperative scheduler: a sample is taken without blocking, so the two
+ * never interleave.
+ */
+
+/* Functions that can be sampled at the same time */
+#define SAMPLER_FUNCTIONS 8
+/* Longest path of a series, longer ones are not recorded */
+#define SAMPLER_PATH_MAX 64
+/* Longest name of a sampled function, with its terminator */
+#define SAMPLER_NAME_MAX 32
+
+struct json_value;
+struct json_arena;
+
+/*
+ * Runs function name for the sampler. rest_request_alloc() allocates from
+ * arena while it runs. Returns the output, or NULL.
+ */
+typedef struct json_value* (*rest_sampler_run_t)(const char* name, struct json_arena* arena);
+
+/*
+ * Starts the sampler thread on the functions of
+ * CONFIG_LIBUKDIAGREST_SAMPLER_FUNCTIONS. Returns 0, or -1 if the thread
+ * could not be created.
+ */
+int rest_sampler_start(rest_sampler_run_t run);
+/*
+ * Sets the sampled functions from the members of settings, an object: each
+ * member is the interval of a function in ms, a non-negative integer, from
+ * now on. 0 stops sampling it: its series are kept, and if it has none its
+ * slot is freed. Either all members are applied or none. Returns 0, or -1
+ * if the table of functions would overflow or a name is too long.
+ */
+int rest_sampler_update(const struct json_value* settings);
+/* Serializes the sampled functions and their intervals like json_serialize() */
+size_t rest_sampler_config(char* buff, size_t buff_len);
+/*
+ * Serializes the samples of function name, of name_len bytes, taken from
+ * from_ms to to_ms after boot like json_serialize():
+ * {"path":[[ms,value],...],...}, oldest first. Returns SIZE_MAX if name was
+ * never sampled.
+ */
+size_t rest_sampler_samples(char* buff, size_t buff_len, const char* name,
+                            size_t name_len, uint64_t from_ms, uint64_t to_ms);
+
+#endif
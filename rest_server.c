@@ -35,126 +35,1536 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-#include <errno.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <lwip/api.h>
 #include <rest.h>
 #include <uk/diagnostic.h>
 #include <uk/json_ir.h>
 #include "json_parser.h"
+#include "json_pbuf.h"
+#include "json_writer.h"
+#include "json_buffer.h"
+#include "json_pool.h"
+#include "json_arena.h"
+#include "json_index.h"
+#include "json_lazy.h"
+#include "json_validate.h"
+#include "json_schema.h"
+#include "json_intern.h"
+#include "json_rpc.h"
+#include "json_projection.h"
+#include "json_aggregate.h"
+#if CONFIG_LIBUKDIAGREST_BENCH
+#include "json_bench.h"
+#endif
+#if CONFIG_LIBUKDIAGREST_SAMPLER
+#include "rest_sampler.h"
+#endif
 
 #define LISTEN_PORT 8123
 static const char header[] = "HTTP/1.1 200 OK\r\n" \
 			    "Content-type: application/json\r\n" \
+			    "Content-Length: %zu\r\n" \
 			    "Connection: close\r\n" \
 			    "\r\n" \
 			    "";
+/* Longest header, with a 20 digit Content-Length */
+#define HEADER_MAX (sizeof(header) + 20)
+
+static const char unavailable[] = "HTTP/1.1 503 Service Unavailable\r\n" \
+				 "Content-Length: 0\r\n" \
+				 "Connection: close\r\n" \
+				 "\r\n";
+
+static const char not_found[] = "HTTP/1.1 404 Not Found\r\n" \
+			       "Content-Length: 0\r\n" \
+			       "Connection: close\r\n" \
+			       "\r\n";
+
+static const char bad_request[] = "HTTP/1.1 400 Bad Request\r\n" \
+				 "Content-Length: 0\r\n" \
+				 "Connection: close\r\n" \
+				 "\r\n";
+
+/* Reply to a JSON-RPC batch of notifications */
+static const char no_content[] = "HTTP/1.1 204 No Content\r\n" \
+				"Connection: close\r\n" \
+				"\r\n";
 
 #define BUFLEN 2048
-static char recvbuf[BUFLEN];
-static char sendbuf[BUFLEN];
+
+/* Checked before a request body is parsed, or received if it is too large */
+static const struct json_limits request_limits = {
+    .max_size = CONFIG_LIBUKDIAGREST_MAX_BODY,
+    .max_depth = JSON_MAX_DEPTH,
+    .max_keys = CONFIG_LIBUKDIAGREST_MAX_KEYS,
+};
+
+/*
+ * The server serves one connection at a time. Its memory is the header
+ * buffer of that connection, the memory of the prepared queries, and the
+ * arena of the request being served, which also holds the reply. In static
+ * mode this is the whole memory budget, and nothing is allocated from the
+ * heap once it is set up.
+ */
+#define PLAN_MEMORY CONFIG_LIBUKDIAGREST_PLAN_MEMORY
+#if CONFIG_LIBUKDIAGREST_STATIC
+#define ARENA_SIZE (CONFIG_LIBUKDIAGREST_MEMORY_BUDGET - BUFLEN - PLAN_MEMORY)
+#if ARENA_SIZE <= 0
+#error "LIBUKDIAGREST_MEMORY_BUDGET is too small"
+#endif
+#else
+#define ARENA_SIZE CONFIG_LIBUKDIAGREST_ARENA_SIZE
+#endif
+
+#if ARENA_SIZE > 0
+static char server_memory[BUFLEN + PLAN_MEMORY + ARENA_SIZE];
+/* Memory of the request being served, reset once the reply is sent */
+static struct json_arena request_arena;
+#else
+static char server_memory[BUFLEN + PLAN_MEMORY];
+#endif
+static char* recvbuf;
+/* Memory of the prepared queries, never reset */
+static struct json_arena plan_arena;
+/* Arena of the request being dispatched, see rest_request_alloc() */
+static struct json_arena* current_arena;
+
+void* rest_request_alloc(size_t size)
+{
+    if (current_arena == NULL)
+        return NULL;
+    return json_arena_alloc(current_arena, size);
+}
+
+void rest_memory_usage(struct rest_memory_usage* usage)
+{
+    usage->budget = sizeof(server_memory);
+    usage->used = BUFLEN + plan_arena.used;
+    usage->peak = BUFLEN + plan_arena.used;
+#if ARENA_SIZE > 0
+    usage->used += request_arena.used;
+    usage->peak += request_arena.peak;
+#endif
+}
+
+/* Functions with declared parameters, see rest_register_function() */
+#define MAX_FUNCTIONS 32
+
+struct registered_function {
+    /* interned, so it is found by comparing pointers */
+    const char* name;
+    rest_function_t function;
+    const struct rest_field* fields;
+    size_t field_count;
+    size_t params_size;
+};
+
+static struct registered_function functions[MAX_FUNCTIONS];
+static size_t function_count;
+
+int rest_register_function(const char* name, rest_function_t function,
+                           const struct rest_field* fields, size_t field_count,
+                           size_t params_size)
+{
+    name = json_intern(name, strlen(name));
+    if (name == NULL)
+        return -1;
+    struct registered_function* entry = NULL;
+    for (size_t i = 0; i < function_count; i++) {
+        if (functions[i].name == name)
+            entry = &functions[i];
+    }
+    if (entry == NULL) {
+        if (function_count == MAX_FUNCTIONS)
+            return -1;
+        entry = &functions[function_count++];
+    }
+    entry->name = name;
+    entry->function = function;
+    entry->fields = fields;
+    entry->field_count = field_count;
+    entry->params_size = params_size;
+    return 0;
+}
+
+/* Keys the parser interned are compared right away, borrowed ones are looked up */
+static const struct registered_function* find_function(const char* name)
+{
+    if (!json_intern_owns(name))
+        name = json_intern_find(name, strlen(name));
+    if (name == NULL)
+        return NULL;
+    for (size_t i = 0; i < function_count; i++) {
+        if (functions[i].name == name)
+            return &functions[i];
+    }
+    return NULL;
+}
+
+enum call_status {
+    CALL_OK,
+    /* the function returned an error */
+    CALL_FAILED,
+    /* the parameters do not match its fields, it was not called */
+    CALL_BAD_PARAMS,
+    CALL_NO_MEMORY,
+};
+
+/*
+ * Decodes the parameters of a registered function into its struct and
+ * calls it. Lazily indexed parameters (params NULL) are decoded from their
+ * bytes in range.
+ */
+static enum call_status call_function(const struct registered_function* function,
+                                      const struct json_value* params,
+                                      struct json_lazy_range* range,
+                                      struct json_arena* arena,
+                                      struct json_value** result)
+{
+    size_t size = function->params_size;
+    void* decoded = NULL;
+    if (size > 0) {
+        decoded = arena != NULL ? json_arena_alloc(arena, size) : json_pool_alloc(size);
+        if (decoded == NULL)
+            return CALL_NO_MEMORY;
+        memset(decoded, 0, size);
+    }
+    bool matches;
+    if (params == NULL)
+        matches = json_schema_decode(range->data, range->len, function->fields,
+                                     function->field_count, decoded);
+    else
+        matches = json_schema_decode_value(params, function->fields,
+                                           function->field_count, decoded);
+    enum call_status status = CALL_BAD_PARAMS;
+    if (matches)
+        status = function->function(decoded, result) == 0 ? CALL_OK : CALL_FAILED;
+    else
+        fprintf(stderr, "Parameters of %s do not match its fields\n", function->name);
+    if (arena == NULL)
+        json_pool_free(decoded, size);
+    return status;
+}
+
+/*
+ * Prepared queries. A plan holds the calls of a request, resolved once:
+ * the registered function and its decoded parameters, or the name and
+ * parameter tree of a diag function, and the serialized key its output
+ * goes under. Plans live in plan_arena and are never released.
+ */
+#define MAX_PLANS 16
+
+struct plan_call {
+    /* NULL for a diag function */
+    const struct registered_function* function;
+    const char* name;
+    /* decoded for function, NULL if they did not match its fields */
+    const void* params;
+    bool matches;
+    /* parameters of a diag function */
+    struct json_value* tree;
+    /* the parameters as they were sent, to recognize a request */
+    const char* text;
+    size_t text_len;
+    /* the serialized key and ':', written ahead of the output */
+    const char* prefix;
+    size_t prefix_len;
+};
+
+struct plan {
+    struct plan_call* calls;
+    size_t count;
+};
+
+static struct plan plans[MAX_PLANS];
+static size_t plan_count;
+
+/* Case insensitive match of a header field name at the start of line */
+static bool header_is(const char* line, const char* end, const char* name)
+{
+    for (; *name != '\0'; line++, name++) {
+        if (line == end || tolower(*line) != tolower(*name))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Returns the body length announced in the request header held in
+ * recvbuf[0, end), or SIZE_MAX if there is no Content-Length header.
+ * A length that does not fit in a size_t is returned as SIZE_MAX - 1, so
+ * it is rejected as too large.
+ */
+static size_t content_length(size_t end)
+{
+    for (size_t line = 0; line < end; ) {
+        size_t eol = line;
+        while (eol < end && recvbuf[eol] != '\n')
+            eol++;
+        if (header_is(&recvbuf[line], &recvbuf[eol], "content-length:")) {
+            size_t pos = line + sizeof("content-length:") - 1;
+            while (pos < eol && recvbuf[pos] == ' ')
+                pos++;
+            size_t length = 0;
+            for (; pos < eol && isdigit(recvbuf[pos]); pos++) {
+                size_t digit = recvbuf[pos] - '0';
+                if (length > (SIZE_MAX - 1 - digit) / 10)
+                    return SIZE_MAX - 1;
+                length = length * 10 + digit;
+            }
+            return length;
+        }
+        line = eol + 1;
+    }
+    return SIZE_MAX;
+}
+
+/* What a request asks for, going by the path of its request line */
+enum request_target {
+    /* call the functions named in the body */
+    TARGET_CALL,
+    /* POST /prepare: store the body as a plan, see prepare_plan() */
+    TARGET_PREPARE,
+    /* /q/<id>: run a stored plan, the body is ignored */
+    TARGET_QUERY,
+    /* POST /rpc: JSON-RPC 2.0, see serve_rpc() */
+    TARGET_RPC,
+    /* /sampler: set the sampled functions, see serve_sampler() */
+    TARGET_SAMPLER,
+    /* /samples/<name>: samples of a function, the body is ignored */
+    TARGET_SAMPLES,
+};
+
+/* What the request line asks for */
+struct request_line {
+    enum request_target target;
+    /* id of the plan of a query */
+    size_t plan;
+    /* bytes of the body, 0 if there is none */
+    size_t body_len;
+    /*
+     * Value of the fields query parameter, a selection of the members of
+     * the reply (see json_projection.h), decoded in recvbuf. NULL if there
+     * is none.
+     */
+    char* fields;
+    size_t fields_len;
+    /* Value of the aggregate query parameter, see json_aggregate.h */
+    char* aggregate;
+    size_t aggregate_len;
+    /* sampled function of /samples/<name>, decoded in recvbuf */
+    char* function;
+    size_t function_len;
+    /* window of the from and to query parameters, in ms after boot */
+    uint64_t from;
+    uint64_t to;
+};
+
+/* Results of the aggregates of one output, see aggregate_result() */
+struct aggregated_output {
+    struct aggregated_output* next;
+    size_t size;
+    /* replaces the output */
+    struct json_value object;
+    struct json_aggregate_nodes nodes[];
+};
+
+/* Options of the query string, built in the memory of the request */
+struct reply_options {
+    struct json_projection* fields;
+    size_t field_count;
+    struct json_aggregate* aggregates;
+    size_t aggregate_count;
+    /* outputs replaced by their aggregates so far */
+    struct aggregated_output* aggregated;
+};
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = tolower(c);
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/* Decodes the %XX escapes and '+' of a query parameter in place */
+static size_t query_decode(char* text, size_t len)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = text[i];
+        if (c == '+') {
+            c = ' ';
+        } else if (c == '%' && i + 2 < len && hex_digit(text[i + 1]) >= 0
+                   && hex_digit(text[i + 2]) >= 0) {
+            c = hex_digit(text[i + 1]) << 4 | hex_digit(text[i + 2]);
+            i += 2;
+        }
+        text[out++] = c;
+    }
+    return out;
+}
+
+/*
+ * Decodes the value of parameter name if it is the parameter in
+ * recvbuf[param, end)
+ */
+static bool query_param(size_t param, size_t end, const char* name, char** value,
+                        size_t* value_len)
+{
+    size_t name_len = strlen(name);
+    if (end - param <= name_len + 1 || memcmp(&recvbuf[param], name, name_len) != 0
+        || recvbuf[param + name_len] != '=')
+        return false;
+    *value = &recvbuf[param + name_len + 1];
+    *value_len = query_decode(*value, end - param - name_len - 1);
+    return true;
+}
+
+/* Value of a query parameter that is a number, or fallback */
+static uint64_t query_number(const char* text, size_t len, uint64_t fallback)
+{
+    uint64_t number = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!isdigit(text[i]) || number > UINT64_MAX / 10)
+            return fallback;
+        number = number * 10 + text[i] - '0';
+    }
+    return len > 0 ? number : fallback;
+}
+
+/* Finds the parameters of the query string recvbuf[pos, end) */
+static void request_query(size_t pos, size_t end, struct request_line* line)
+{
+    while (pos < end) {
+        size_t param = pos;
+        while (pos < end && recvbuf[pos] != '&')
+            pos++;
+        char* value;
+        size_t value_len;
+        if (query_param(param, pos, "from", &value, &value_len))
+            line->from = query_number(value, value_len, line->from);
+        else if (query_param(param, pos, "to", &value, &value_len))
+            line->to = query_number(value, value_len, line->to);
+        else if (!query_param(param, pos, "fields", &line->fields, &line->fields_len))
+            query_param(param, pos, "aggregate", &line->aggregate, &line->aggregate_len);
+        pos++;
+    }
+}
+
+/* Reads the request line at the start of recvbuf[0, end) into line */
+static void request_target(size_t end, struct request_line* line)
+{
+    size_t pos = 0;
+    while (pos < end && recvbuf[pos] != ' ')
+        pos++;
+    size_t path = ++pos;
+    while (pos < end && recvbuf[pos] != ' ' && recvbuf[pos] != '\r' && recvbuf[pos] != '?')
+        pos++;
+    size_t path_len = pos - path;
+    if (pos < end && recvbuf[pos] == '?') {
+        size_t query = ++pos;
+        while (pos < end && recvbuf[pos] != ' ' && recvbuf[pos] != '\r')
+            pos++;
+        request_query(query, pos, line);
+    }
+
+    line->target = TARGET_CALL;
+    if (path_len == sizeof("/prepare") - 1
+        && memcmp(&recvbuf[path], "/prepare", path_len) == 0)
+        line->target = TARGET_PREPARE;
+    if (path_len == sizeof("/rpc") - 1 && memcmp(&recvbuf[path], "/rpc", path_len) == 0)
+        line->target = TARGET_RPC;
+#if CONFIG_LIBUKDIAGREST_SAMPLER
+    if (path_len == sizeof("/sampler") - 1
+        && memcmp(&recvbuf[path], "/sampler", path_len) == 0)
+        line->target = TARGET_SAMPLER;
+    if (path_len > 9 && memcmp(&recvbuf[path], "/samples/", 9) == 0) {
+        line->target = TARGET_SAMPLES;
+        line->function = &recvbuf[path + 9];
+        line->function_len = query_decode(line->function, path_len - 9);
+    }
+#endif
+    if (path_len > 3 && memcmp(&recvbuf[path], "/q/", 3) == 0) {
+        line->target = TARGET_QUERY;
+        line->plan = 0;
+        for (size_t i = path + 3; i < path + path_len; i++) {
+            if (!isdigit(recvbuf[i]) || line->plan > MAX_PLANS) {
+                line->plan = SIZE_MAX;
+                break;
+            }
+            line->plan = line->plan * 10 + recvbuf[i] - '0';
+        }
+    }
+}
+
+/* Returns the pbuf of the chain holding byte *offset, made relative to it */
+static struct pbuf* pbuf_at(struct pbuf* p, size_t* offset)
+{
+    while (p != NULL && *offset >= p->len) {
+        *offset -= p->len;
+        p = p->next;
+    }
+    return p;
+}
+
+/*
+ * Receives a request from client and parses its body where lwIP received
+ * it, pbuf by pbuf as the segments arrive. Only the request header is
+ * copied into recvbuf, to find its end and the Content-Length. Without a
+ * Content-Length the body is whatever arrived together with the header.
+ * A body over request_limits.max_size is dropped unreceived, and the
+ * parser stops at request_limits.max_keys members. A body that is
+ * malformed or over these limits is returned as a JSON_ERROR value, which
+ * the server answers with 400 Bad Request.
+ *
+ * If the whole body sits in a single pbuf, which is the case for most
+ * requests, whether it came with the header or in a netbuf of its own,
+ * it is first checked with json_validate(), so garbage is turned
+ * away before anything is allocated for it. It is then parsed in situ and
+ * its strings are borrowed from the pbuf. The netbuf holding it is then
+ * returned in *insitu and has to be deleted after releasing the tree with
+ * release_request().
+ *
+ * In lazy mode such a body is only indexed with parse_json_lazy(): the
+ * member values of the returned tree are NULL and are parsed from lazy
+ * at dispatch. lazy is left empty otherwise, and for requests that are not
+ * calls or prepared, such as JSON-RPC batches, which are arrays.
+ *
+ * The tree is allocated from arena, or from the pools if it is NULL.
+ * If it does not fit, *over_budget is set. A body larger than the whole
+ * arena is rejected that way without being received.
+ *
+ * The request line is read into *line. The body of a query or of a
+ * request for samples is not parsed, NULL is returned for it.
+ */
+static struct json_value* receive_request(struct netconn* client,
+                                          struct netbuf** insitu,
+                                          struct json_arena* arena,
+                                          struct json_lazy* lazy,
+                                          struct request_line* line,
+                                          bool* over_budget)
+{
+    struct json_parser parser;
+    json_parser_init(&parser);
+    parser.arena = arena;
+    parser.max_keys = request_limits.max_keys;
+    size_t filled = 0;
+    bool in_body = false;
+    size_t length = 0;
+    size_t received = 0;
+    struct netbuf* buf;
+
+    *insitu = NULL;
+    memset(line, 0, sizeof *line);
+    line->target = TARGET_CALL;
+    line->to = UINT64_MAX;
+    *over_budget = false;
+    memset(lazy, 0, sizeof *lazy);
+    while ((!in_body || received < length)
+           && netconn_recv(client, &buf) == ERR_OK) {
+        size_t offset = 0;
+        size_t buf_len = netbuf_len(buf);
+        if (!in_body) {
+            /* Copy header bytes until the empty line ending the header */
+            while (offset < buf_len && filled < BUFLEN && !in_body) {
+                recvbuf[filled++] = pbuf_get_at(buf->p, offset++);
+                in_body = filled >= 4
+                    && memcmp(&recvbuf[filled - 4], "\r\n\r\n", 4) == 0;
+            }
+            if (in_body) {
+                request_target(filled, line);
+                if (line->target == TARGET_QUERY || line->target == TARGET_SAMPLES) {
+                    /* the reply does not wait for a body */
+                    netbuf_delete(buf);
+                    return NULL;
+                }
+                length = content_length(filled);
+                if (length == SIZE_MAX)
+                    length = buf_len - offset;
+                line->body_len = length;
+                if (length > request_limits.max_size) {
+                    fprintf(stderr, "Request body too large\n");
+                    parser.error = true;
+                    netbuf_delete(buf);
+                    break;
+                }
+                if (arena != NULL && length > arena->size) {
+                    *over_budget = true;
+                    parser.error = true;
+                    netbuf_delete(buf);
+                    break;
+                }
+            } else if (filled == BUFLEN) {
+                fprintf(stderr, "Request header too large\n");
+                parser.error = true;
+            }
+        }
+        if (in_body && !parser.error && received == 0) {
+            /* none of the body was fed yet, it may all be in one pbuf */
+            size_t body = offset;
+            struct pbuf* p = pbuf_at(buf->p, &body);
+            if (length > 0 && p != NULL && p->len - body >= length) {
+                char* data = (char*) p->payload + body;
+                *insitu = buf;
+                if (!json_validate(data, length, &request_limits)) {
+                    parser.error = true;
+                    return json_parser_finish(&parser);
+                }
+#if CONFIG_LIBUKDIAGREST_LAZY
+                if (line->target == TARGET_CALL || line->target == TARGET_PREPARE) {
+                    struct json_value* json = parse_json_lazy(data, length, arena, lazy);
+                    *over_budget = lazy->out_of_memory;
+                    return json;
+                }
+#endif
+                parser.insitu = true;
+                json_parser_feed(&parser, data, length);
+                *over_budget = parser.out_of_memory;
+                return json_parser_finish(&parser);
+            }
+        }
+        if (in_body && !parser.error) {
+            size_t chunk = buf_len - offset;
+            if (chunk > length - received)
+                chunk = length - received;
+            json_parser_feed_pbuf(&parser, buf->p, offset, chunk);
+            received += chunk;
+        }
+        netbuf_delete(buf);
+        if (parser.error)
+            break;
+    }
+    *over_budget = *over_budget || parser.out_of_memory;
+    return json_parser_finish(&parser);
+}
+
+/* Releases a request tree received with receive_request() */
+static void release_request(struct json_value* json, struct netbuf* insitu,
+                            struct json_arena* arena, struct json_lazy* lazy)
+{
+    json_lazy_release(lazy);
+    if (arena == NULL) {
+        if (insitu != NULL)
+            free_json_value_insitu(json);
+        else
+            free_json_value_pooled(json);
+    }
+    if (insitu != NULL)
+        netbuf_delete(insitu);
+}
+
+static struct json_value* new_outputs(struct json_arena* arena)
+{
+    if (arena == NULL)
+        return json_pool_value(JSON_OBJECT);
+    struct json_value* outputs = json_arena_alloc(arena, sizeof *outputs);
+    if (outputs != NULL) {
+        outputs->type = JSON_OBJECT;
+        outputs->object = NULL;
+    }
+    return outputs;
+}
+
+static struct json_object* new_output(struct json_arena* arena)
+{
+    if (arena == NULL)
+        return json_pool_object();
+    return json_arena_alloc(arena, sizeof(struct json_object));
+}
+
+/*
+ * Diag functions allocate their results on the heap, or in the request
+ * arena through rest_request_alloc()
+ */
+static void release_result(struct json_value* result, struct json_arena* arena)
+{
+    if (arena == NULL || !json_arena_owns(arena, result))
+        free_json_value(result);
+}
+
+/* Whether value is the aggregates of an output, see aggregate_result() */
+static bool is_aggregated(const struct reply_options* options, const struct json_value* value)
+{
+    for (const struct aggregated_output* output = options->aggregated; output != NULL;
+         output = output->next) {
+        if (value == &output->object)
+            return true;
+    }
+    return false;
+}
+
+/* Outputs replaced by their aggregates are left to release_options() */
+static void release_outputs(struct json_value* outputs, const struct reply_options* options,
+                            struct json_arena* arena)
+{
+    for (struct json_object* obj = outputs->object; obj != NULL; obj = obj->next) {
+        if (!is_aggregated(options, obj->value))
+            release_result(obj->value, arena);
+        obj->value = NULL;
+    }
+    if (arena == NULL)
+        json_pool_release(outputs, false);
+}
+
+/* Rejects a request that does not fit the memory of the server */
+static void send_unavailable(struct netconn* client)
+{
+    fprintf(stderr, "Request over the memory budget\n");
+    netconn_write(client, unavailable, sizeof(unavailable) - 1, NETCONN_COPY);
+}
+
+/* Rejects a request whose body is not the JSON it has to be */
+static void send_malformed(struct netconn* client)
+{
+    fprintf(stderr, "Malformed request body\n");
+    netconn_write(client, bad_request, sizeof(bad_request) - 1, NETCONN_COPY);
+}
+
+/* '\0' terminated copy of len bytes of data in the plan memory */
+static char* plan_copy(const char* data, size_t len)
+{
+    char* copy = json_arena_alloc(&plan_arena, len + 1);
+    if (copy != NULL) {
+        memcpy(copy, data, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+/*
+ * Resolves member of a request into call. Lazily indexed parameters are
+ * copied as they were sent, others are serialized. Returns false if the
+ * plan memory is full.
+ */
+static bool prepare_call(struct plan_call* call, const struct json_object* obj,
+                         const struct json_lazy_range* range)
+{
+    memset(call, 0, sizeof *call);
+    if (obj->value == NULL) {
+        call->text = plan_copy(range->data, range->len);
+        call->text_len = range->len;
+    } else {
+        call->text_len = json_measure(obj->value);
+        char* text = json_arena_alloc(&plan_arena, call->text_len + 1);
+        if (text != NULL)
+            json_serialize(text, call->text_len + 1, obj->value);
+        call->text = text;
+    }
+    if (call->text == NULL)
+        return false;
+
+    struct json_value key = { .type = JSON_STRING, .string = obj->key };
+    size_t key_len = json_measure(&key);
+    char* prefix = json_arena_alloc(&plan_arena, key_len + 2);
+    if (prefix == NULL)
+        return false;
+    json_serialize(prefix, key_len + 1, &key);
+    prefix[key_len] = ':';
+    call->prefix = prefix;
+    call->prefix_len = key_len + 1;
+
+    /* decoded and parsed in place, strings are borrowed from it */
+    char* params = plan_copy(call->text, call->text_len);
+    if (params == NULL)
+        return false;
+    call->function = find_function(obj->key);
+    if (call->function != NULL) {
+        call->name = call->function->name;
+        size_t size = call->function->params_size;
+        void* decoded = NULL;
+        if (size > 0) {
+            decoded = json_arena_alloc(&plan_arena, size);
+            if (decoded == NULL)
+                return false;
+            memset(decoded, 0, size);
+        }
+        call->matches = json_schema_decode(params, call->text_len, call->function->fields,
+                                           call->function->field_count, decoded);
+        call->params = call->matches ? decoded : NULL;
+        return true;
+    }
+    call->name = plan_copy(obj->key, strlen(obj->key));
+    struct json_parser parser;
+    json_parser_init(&parser);
+    parser.arena = &plan_arena;
+    parser.insitu = true;
+    json_parser_feed(&parser, params, call->text_len);
+    call->tree = json_parser_finish(&parser);
+    return call->name != NULL && call->tree->type != JSON_ERROR;
+}
+
+/* Buffer for a reply with a body of size bytes, NULL if there is no room */
+static char* reply_buffer(struct json_arena* arena, size_t size)
+{
+    char* sendbuf = NULL;
+    if (arena != NULL)
+        sendbuf = json_arena_alloc(arena, HEADER_MAX + size + 1);
+#if !CONFIG_LIBUKDIAGREST_STATIC
+    if (sendbuf == NULL)
+        sendbuf = json_buffer_get(HEADER_MAX + size + 1);
+#endif
+    return sendbuf;
+}
+
+/* True if member obj has the name and parameters of call */
+static bool same_call(const struct plan_call* call, const struct json_object* obj,
+                      const struct json_lazy_range* range, struct json_arena* arena)
+{
+    if (strcmp(call->name, obj->key) != 0)
+        return false;
+    if (obj->value == NULL)
+        return range->len == call->text_len
+            && memcmp(range->data, call->text, call->text_len) == 0;
+    if (json_measure(obj->value) != call->text_len)
+        return false;
+    char* text = reply_buffer(arena, call->text_len);
+    if (text == NULL)
+        return false;
+    json_serialize(text, call->text_len + 1, obj->value);
+    bool same = memcmp(text, call->text, call->text_len) == 0;
+    if (arena == NULL || !json_arena_owns(arena, text))
+        json_buffer_put(text);
+    return same;
+}
+
+/* Id of the plan prepared from the same request before, or SIZE_MAX */
+static size_t find_plan(const struct json_value* json, const struct json_lazy* lazy,
+                        struct json_arena* arena)
+{
+    for (size_t id = 0; id < plan_count; id++) {
+        const struct plan* plan = &plans[id];
+        size_t member = 0;
+        const struct json_object* obj = json->object;
+        for (; obj != NULL && member < plan->count; obj = obj->next, member++) {
+            const struct json_lazy_range* range =
+                obj->value == NULL ? &lazy->ranges[member] : NULL;
+            if (!same_call(&plan->calls[member], obj, range, arena))
+                break;
+        }
+        if (obj == NULL && member == plan->count)
+            return id;
+    }
+    return SIZE_MAX;
+}
+
+/*
+ * Stores the calls of request json as a plan and returns its id, or
+ * SIZE_MAX if there is no room for it. Pollers prepare the same request
+ * again after they restart, it gets the id it got before.
+ */
+static size_t prepare_plan(const struct json_value* json, const struct json_lazy* lazy,
+                           struct json_arena* arena)
+{
+    size_t id = find_plan(json, lazy, arena);
+    if (id != SIZE_MAX || plan_count == MAX_PLANS)
+        return id;
+
+    struct json_arena saved = plan_arena;
+    struct plan plan = { NULL, 0 };
+    for (const struct json_object* obj = json->object; obj != NULL; obj = obj->next)
+        plan.count++;
+    plan.calls = json_arena_alloc(&plan_arena, plan.count * sizeof *plan.calls);
+    if (plan.calls == NULL)
+        goto full;
+    size_t member = 0;
+    for (const struct json_object* obj = json->object; obj != NULL; obj = obj->next, member++) {
+        const struct json_lazy_range* range = obj->value == NULL ? &lazy->ranges[member] : NULL;
+        if (!prepare_call(&plan.calls[member], obj, range))
+            goto full;
+    }
+    plans[plan_count] = plan;
+    return plan_count++;
+
+full:
+    /* the plan memory is only ever appended to, drop what was added */
+    plan_arena = saved;
+    return SIZE_MAX;
+}
+
+static void send_reply(struct netconn* client, char* sendbuf, size_t size,
+                       struct json_arena* arena)
+{
+    if (netconn_write(client, sendbuf, size, NETCONN_COPY) != ERR_OK)
+        fprintf(stderr, "Failed to send a reply\n");
+    if (arena == NULL || !json_arena_owns(arena, sendbuf))
+        json_buffer_put(sendbuf);
+}
+
+/* Prepares request json and replies with the id of its plan */
+static void serve_prepare(struct netconn* client, const struct json_value* json,
+                          const struct json_lazy* lazy, struct json_arena* arena)
+{
+    size_t id = prepare_plan(json, lazy, arena);
+    if (id == SIZE_MAX) {
+        send_unavailable(client);
+        return;
+    }
+    char body[32];
+    size_t size = snprintf(body, sizeof(body), "{\"id\":%zu}", id);
+    char* sendbuf = reply_buffer(arena, size);
+    if (sendbuf == NULL) {
+        send_unavailable(client);
+        return;
+    }
+    size_t header_size = snprintf(sendbuf, HEADER_MAX, header, size);
+    memcpy(&sendbuf[header_size], body, size);
+    send_reply(client, sendbuf, header_size + size, arena);
+}
+
+static void release_options(struct reply_options* options, struct json_arena* arena)
+{
+    if (arena != NULL)
+        return;
+    if (options->fields != NULL)
+        json_pool_free(options->fields, options->field_count * sizeof *options->fields);
+    if (options->aggregates != NULL)
+        json_pool_free(options->aggregates,
+                       options->aggregate_count * sizeof *options->aggregates);
+    while (options->aggregated != NULL) {
+        struct aggregated_output* output = options->aggregated;
+        options->aggregated = output->next;
+        json_pool_free(output, output->size);
+    }
+}
+
+/*
+ * Builds the options of the query string of line in the memory of the
+ * request. Replies and returns false if one is malformed or they do not
+ * fit.
+ */
+static bool request_options(struct netconn* client, const struct request_line* line,
+                            struct json_arena* arena, struct reply_options* options)
+{
+    memset(options, 0, sizeof *options);
+    bool malformed = false;
+    if (line->fields != NULL) {
+        options->field_count = json_projection_count(line->fields, line->fields_len);
+        malformed = options->field_count == 0;
+    }
+    if (line->aggregate != NULL) {
+        options->aggregate_count = json_aggregate_count(line->aggregate, line->aggregate_len);
+        malformed = malformed || options->aggregate_count == 0;
+    }
+    if (malformed) {
+        fprintf(stderr, "Malformed query string\n");
+        netconn_write(client, bad_request, sizeof(bad_request) - 1, NETCONN_COPY);
+        return false;
+    }
+
+    size_t fields_size = options->field_count * sizeof *options->fields;
+    size_t aggregates_size = options->aggregate_count * sizeof *options->aggregates;
+    if (fields_size > 0)
+        options->fields = arena != NULL ? json_arena_alloc(arena, fields_size)
+                                        : json_pool_alloc(fields_size);
+    if (aggregates_size > 0)
+        options->aggregates = arena != NULL ? json_arena_alloc(arena, aggregates_size)
+                                            : json_pool_alloc(aggregates_size);
+    if ((fields_size > 0 && options->fields == NULL)
+        || (aggregates_size > 0 && options->aggregates == NULL)) {
+        release_options(options, arena);
+        memset(options, 0, sizeof *options);
+        send_unavailable(client);
+        return false;
+    }
+    if (options->fields != NULL)
+        json_projection_parse(line->fields, line->fields_len, options->fields);
+    if (options->aggregates != NULL)
+        json_aggregate_parse(line->aggregate, line->aggregate_len, options->aggregates);
+    return true;
+}
+
+/*
+ * Replaces the output of name in *result by its aggregates, if it has any.
+ * The result is released, only the aggregates are sent. They are built in
+ * nodes of their own, so outputs of the same name do not share any, and
+ * release_options() releases them. Returns false, with *result NULL, if
+ * the nodes do not fit.
+ */
+static bool aggregate_result(struct reply_options* options, const char* name,
+                             struct json_value** result, struct json_arena* arena)
+{
+    size_t matches = json_aggregate_matches(options->aggregates, options->aggregate_count,
+                                            name);
+    if (matches == 0)
+        return true;
+    size_t size = sizeof(struct aggregated_output)
+        + matches * sizeof(struct json_aggregate_nodes);
+    struct aggregated_output* output = arena != NULL ? json_arena_alloc(arena, size)
+                                                     : json_pool_alloc(size);
+    if (output != NULL) {
+        output->next = options->aggregated;
+        output->size = size;
+        options->aggregated = output;
+        json_aggregate_output(options->aggregates, options->aggregate_count, name, *result,
+                              &output->object, output->nodes);
+    }
+    release_result(*result, arena);
+    *result = output != NULL ? &output->object : NULL;
+    return output != NULL;
+}
+
+/* Releases a result that may have been replaced by aggregate_result() */
+static void release_reply_result(const struct reply_options* options,
+                                 struct json_value* result, struct json_arena* arena)
+{
+    if (!is_aggregated(options, result))
+        release_result(result, arena);
+}
+
+/* Whether fields selects the output of call, and the selection within it */
+static bool plan_selects(const struct json_projection* fields, const struct plan_call* call,
+                         const struct json_projection** selection)
+{
+    *selection = NULL;
+    if (fields == NULL)
+        return true;
+    const struct json_projection* field = json_projection_find(fields, call->name);
+    if (field != NULL)
+        *selection = field->fields;
+    return field != NULL;
+}
+
+/*
+ * Runs the calls of a plan. Nothing is parsed or looked up, and the reply
+ * is the serialized keys of the plan with the outputs in between.
+ */
+static void serve_query(struct netconn* client, const struct request_line* line,
+                        struct json_arena* arena)
+{
+    if (line->plan >= plan_count) {
+        netconn_write(client, not_found, sizeof(not_found) - 1, NETCONN_COPY);
+        return;
+    }
+    struct reply_options options;
+    if (!request_options(client, line, arena, &options))
+        return;
+    const struct json_projection* fields = options.fields;
+    const struct plan* plan = &plans[line->plan];
+    size_t results_size = plan->count * sizeof(struct json_value*);
+    struct json_value** results = arena != NULL ? json_arena_alloc(arena, results_size)
+                                                : json_pool_alloc(results_size);
+    if (results == NULL) {
+        send_unavailable(client);
+        release_options(&options, arena);
+        return;
+    }
+
+    bool over_budget = false;
+    current_arena = arena;
+    for (size_t i = 0; i < plan->count; i++) {
+        const struct plan_call* call = &plan->calls[i];
+        results[i] = NULL;
+        if (call->function == NULL)
+            run_diag_function(call->name, call->tree, &results[i]);
+        else if (call->matches)
+            call->function->function(call->params, &results[i]);
+        if (!aggregate_result(&options, call->name, &results[i], arena))
+            over_budget = true;
+    }
+    current_arena = NULL;
+    json_index_clear();
+
+    /* braces, and a separator ahead of every output but the first */
+    size_t size = 1;
+    const struct json_projection* selection;
+    for (size_t i = 0; i < plan->count; i++) {
+        if (plan_selects(fields, &plan->calls[i], &selection))
+            size += 1 + plan->calls[i].prefix_len + json_measure_projected(results[i], selection);
+    }
+    size = size > 1 ? size : 2;
+    char* sendbuf = over_budget ? NULL : reply_buffer(arena, size);
+    if (sendbuf != NULL) {
+        size_t pos = snprintf(sendbuf, HEADER_MAX, header, size);
+        size_t start = pos;
+        sendbuf[pos++] = '{';
+        for (size_t i = 0; i < plan->count; i++) {
+            if (!plan_selects(fields, &plan->calls[i], &selection))
+                continue;
+            if (pos > start + 1)
+                sendbuf[pos++] = ',';
+            memcpy(&sendbuf[pos], plan->calls[i].prefix, plan->calls[i].prefix_len);
+            pos += plan->calls[i].prefix_len;
+            pos += json_serialize_projected(&sendbuf[pos], HEADER_MAX + size + 1 - pos,
+                                            results[i], selection);
+        }
+        sendbuf[pos++] = '}';
+        send_reply(client, sendbuf, pos, arena);
+    } else {
+        send_unavailable(client);
+    }
+
+    for (size_t i = 0; i < plan->count; i++)
+        release_reply_result(&options, results[i], arena);
+    if (arena == NULL)
+        json_pool_free(results, results_size);
+    release_options(&options, arena);
+}
+
+/* params of a JSON-RPC call that has none */
+static struct json_value rpc_no_params = { .type = JSON_NULL };
+
+/* Runs a call read with json_rpc_read(), unless it is invalid already */
+static void rpc_call(struct json_rpc_call* call, struct json_arena* arena, bool* over_budget)
+{
+    if (call->error != 0)
+        return;
+    if (call->params == NULL)
+        call->params = &rpc_no_params;
+    const struct registered_function* function = find_function(call->method);
+    if (function == NULL) {
+        call->error = JSON_RPC_METHOD_NOT_FOUND;
+        return;
+    }
+    switch (call_function(function, call->params, NULL, arena, &call->result)) {
+        case CALL_OK:
+            break;
+        case CALL_FAILED:
+            call->error = JSON_RPC_CALL_FAILED;
+            break;
+        case CALL_BAD_PARAMS:
+            call->error = JSON_RPC_INVALID_PARAMS;
+            break;
+        case CALL_NO_MEMORY:
+            *over_budget = true;
+            break;
+    }
+}
+
+/*
+ * JSON-RPC 2.0: json is a call or a batch array of calls. Unlike the
+ * members of a plain request, the calls of a batch may name the same
+ * function, and each one fails on its own with an error response. They
+ * run one after another on the server thread, which owns the pools and
+ * the arena, and are answered in batch order. A body that does not parse
+ * gets a parse error, a batch of notifications an empty 204. A call may
+ * select the members of its result with a "fields" selection, the fields
+ * query parameter of the request line is not used. Only registered
+ * functions can be called, any other method is not found.
+ */
+static void serve_rpc(struct netconn* client, const struct json_value* json,
+                      bool over_budget, struct json_arena* arena)
+{
+    if (over_budget) {
+        send_unavailable(client);
+        return;
+    }
+    /* an empty batch is a single invalid request */
+    bool batch = json->type == JSON_ARRAY && json->array->size > 0;
+    size_t count = batch ? json->array->size : 1;
+    size_t calls_size = count * sizeof(struct json_rpc_call);
+    struct json_rpc_call* calls = arena != NULL ? json_arena_alloc(arena, calls_size)
+                                                : json_pool_alloc(calls_size);
+    if (calls == NULL) {
+        send_unavailable(client);
+        return;
+    }
+    if (json->type == JSON_ERROR) {
+        memset(calls, 0, sizeof *calls);
+        calls->error = JSON_RPC_PARSE_ERROR;
+    }
+    for (size_t i = 0; i < count && json->type != JSON_ERROR; i++)
+        json_rpc_read(batch ? json->array->values[i] : json, &calls[i]);
+
+    /* the selections of all calls are built in one block */
+    size_t field_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (calls[i].error != 0 || calls[i].fields == NULL)
+            continue;
+        size_t names = json_projection_count(calls[i].fields, strlen(calls[i].fields));
+        if (names == 0)
+            calls[i].error = JSON_RPC_INVALID_REQUEST;
+        field_count += names;
+    }
+    struct json_projection* fields = NULL;
+    size_t fields_size = field_count * sizeof *fields;
+    if (field_count > 0) {
+        fields = arena != NULL ? json_arena_alloc(arena, fields_size)
+                               : json_pool_alloc(fields_size);
+        over_budget = fields == NULL;
+    }
+    for (size_t i = 0, used = 0; i < count && !over_budget; i++) {
+        if (calls[i].error != 0 || calls[i].fields == NULL)
+            continue;
+        size_t len = strlen(calls[i].fields);
+        calls[i].projection = json_projection_parse(calls[i].fields, len, &fields[used]);
+        used += json_projection_count(calls[i].fields, len);
+    }
+
+    current_arena = arena;
+    for (size_t i = 0; i < count && !over_budget; i++)
+        rpc_call(&calls[i], arena, &over_budget);
+    current_arena = NULL;
+    json_index_clear();
+
+    size_t size = json_rpc_serialize(NULL, 0, calls, count, batch);
+    char* sendbuf = NULL;
+    if (!over_budget && size > 0)
+        sendbuf = reply_buffer(arena, size);
+    if (sendbuf != NULL) {
+        size_t header_size = snprintf(sendbuf, HEADER_MAX, header, size);
+        json_rpc_serialize(&sendbuf[header_size], size + 1, calls, count, batch);
+        send_reply(client, sendbuf, header_size + size, arena);
+    } else if (!over_budget && size == 0) {
+        netconn_write(client, no_content, sizeof(no_content) - 1, NETCONN_COPY);
+    } else {
+        send_unavailable(client);
+    }
+
+    for (size_t i = 0; i < count; i++)
+        release_result(calls[i].result, arena);
+    if (arena == NULL) {
+        json_pool_free(calls, calls_size);
+        if (fields != NULL)
+            json_pool_free(fields, fields_size);
+    }
+}
+
+#if CONFIG_LIBUKDIAGREST_SAMPLER
+/* Parameters of sampled functions */
+static struct json_value sample_params = { .type = JSON_OBJECT };
+
+/* Runs a function for the sampler thread, see rest_sampler_run_t */
+static struct json_value* sample_function(const char* name, struct json_arena* arena)
+{
+    struct json_value* result = NULL;
+    struct json_arena* saved = current_arena;
+    current_arena = arena;
+    /* not find_function(), the intern table belongs to the server thread */
+    const struct registered_function* function = NULL;
+    for (size_t i = 0; i < function_count && function == NULL; i++) {
+        if (strcmp(functions[i].name, name) == 0)
+            function = &functions[i];
+    }
+    if (function == NULL)
+        run_diag_function(name, &sample_params, &result);
+    else if (call_function(function, &sample_params, NULL, arena, &result) == CALL_NO_MEMORY)
+        result = NULL;
+    json_index_clear();
+    current_arena = saved;
+    return result;
+}
+
+/*
+ * Sets the sampled functions from the members of json, each the interval
+ * of a registered function in ms, 0 to stop sampling it. Any other body,
+ * or none, leaves them as they are, but one that does not parse is a bad
+ * request. So is a member that is not a non-negative integer or does not
+ * name a registered function, and nothing is applied then, nor if the
+ * table of sampled functions would overflow. The reply is the functions
+ * and their intervals.
+ */
+static void serve_sampler(struct netconn* client, const struct request_line* line,
+                          const struct json_value* json, bool over_budget,
+                          struct json_arena* arena)
+{
+    if (over_budget) {
+        send_unavailable(client);
+        return;
+    }
+    if (json->type == JSON_ERROR && line->body_len > 0) {
+        send_malformed(client);
+        return;
+    }
+    if (json->type == JSON_OBJECT) {
+        for (const struct json_object* obj = json->object; obj != NULL; obj = obj->next) {
+            if (obj->value->type != JSON_INT || obj->value->integer < 0
+                || find_function(obj->key) == NULL) {
+                netconn_write(client, bad_request, sizeof(bad_request) - 1, NETCONN_COPY);
+                return;
+            }
+        }
+        if (rest_sampler_update(json) != 0) {
+            fprintf(stderr, "Cannot sample all of the functions\n");
+            send_unavailable(client);
+            return;
+        }
+    }
+    size_t size = rest_sampler_config(NULL, 0);
+    char* sendbuf = reply_buffer(arena, size);
+    if (sendbuf == NULL) {
+        send_unavailable(client);
+        return;
+    }
+    size_t header_size = snprintf(sendbuf, HEADER_MAX, header, size);
+    rest_sampler_config(&sendbuf[header_size], size + 1);
+    send_reply(client, sendbuf, header_size + size, arena);
+}
+
+/* Replies with the samples of the function of line in its window */
+static void serve_samples(struct netconn* client, const struct request_line* line,
+                          struct json_arena* arena)
+{
+    size_t size = rest_sampler_samples(NULL, 0, line->function, line->function_len,
+                                       line->from, line->to);
+    if (size == SIZE_MAX) {
+        netconn_write(client, not_found, sizeof(not_found) - 1, NETCONN_COPY);
+        return;
+    }
+    char* sendbuf = reply_buffer(arena, size);
+    if (sendbuf == NULL) {
+        send_unavailable(client);
+        return;
+    }
+    size_t header_size = snprintf(sendbuf, HEADER_MAX, header, size);
+    rest_sampler_samples(&sendbuf[header_size], size + 1, line->function,
+                         line->function_len, line->from, line->to);
+    send_reply(client, sendbuf, header_size + size, arena);
+}
+#endif
+
+#if CONFIG_LIBUKDIAGREST_MEMORY_STATS
+static void print_memory_stats(struct json_arena* arena)
+{
+    if (arena != NULL) {
+        struct rest_memory_usage usage;
+        rest_memory_usage(&usage);
+        printf("memory: %lu of %lu bytes used, %lu peak\n", usage.used,
+               usage.budget, usage.peak);
+        return;
+    }
+    struct json_pool_stats stats;
+    json_pool_get_stats(&stats);
+    size_t hits = stats.values.hits + stats.objects.hits + stats.arrays.hits;
+    size_t misses = stats.values.misses + stats.objects.misses + stats.arrays.misses;
+    for (size_t i = 0; i < JSON_POOL_SLABS; i++) {
+        hits += stats.slabs[i].hits;
+        misses += stats.slabs[i].misses;
+    }
+    printf("pools: %lu hits, %lu misses, %lu large\n", hits, misses, stats.large);
+}
+#endif
 
 int rest_server()
 {
 	int rc = 0;
-	int srv, client;
-	ssize_t n;
-	struct sockaddr_in srv_addr;
+	err_t err;
+	struct netconn *srv, *client;
 
-	srv = socket(AF_INET, SOCK_STREAM, 0);
-	if (srv < 0) {
-		fprintf(stderr, "Failed to create socket: %d\n", errno);
+	srv = netconn_new(NETCONN_TCP);
+	if (srv == NULL) {
+		fprintf(stderr, "Failed to create connection\n");
+		rc = -1;
 		goto out;
 	}
 
-	srv_addr.sin_family = AF_INET;
-	srv_addr.sin_addr.s_addr = INADDR_ANY;
-	srv_addr.sin_port = htons(LISTEN_PORT);
-
-	rc = bind(srv, (struct sockaddr *) &srv_addr, sizeof(srv_addr));
-	if (rc < 0) {
-		fprintf(stderr, "Failed to bind socket: %d\n", errno);
+	err = netconn_bind(srv, IP_ADDR_ANY, LISTEN_PORT);
+	if (err != ERR_OK) {
+		fprintf(stderr, "Failed to bind connection: %d\n", err);
+		rc = -1;
 		goto out;
 	}
 
 	/* Accept one simultaneous connection */
-	rc = listen(srv, 1);
-	if (rc < 0) {
-		fprintf(stderr, "Failed to listen on socket: %d\n", errno);
+	err = netconn_listen_with_backlog(srv, 1);
+	if (err != ERR_OK) {
+		fprintf(stderr, "Failed to listen on connection: %d\n", err);
+		rc = -1;
 		goto out;
 	}
 
-    const size_t header_size = snprintf(&sendbuf[0], BUFLEN, "%s", &header[0]);
-    char* buff = &sendbuf[header_size];
-    const size_t buff_len = BUFLEN - header_size;
+#if CONFIG_LIBUKDIAGREST_BENCH
+    json_bench();
+#endif
+#if CONFIG_LIBUKDIAGREST_SAMPLER
+    rest_sampler_start(sample_function);
+#endif
+    recvbuf = server_memory;
+    json_arena_init(&plan_arena, &server_memory[BUFLEN], PLAN_MEMORY);
+#if ARENA_SIZE > 0
+    json_arena_init(&request_arena, &server_memory[BUFLEN + PLAN_MEMORY], ARENA_SIZE);
+#endif
 
 	printf("Listening on port %d...\n", LISTEN_PORT);
 	while (1) {
-		client = accept(srv, NULL, 0);
-		if (client < 0) {
+		err = netconn_accept(srv, &client);
+		if (err != ERR_OK) {
 			fprintf(stderr,
 				"Failed to accept incoming connection: %d\n",
-				errno);
+				err);
+			rc = -1;
 			goto out;
 		}
 
-		/* Receive some bytes (ignore errors) */
-		ssize_t bytes = read(client, recvbuf, BUFLEN);
-
-        if (bytes < 0) {
-			fprintf(stderr,
-				"Failed to read request: %d\n",
-				errno);
-            close(client);
+        struct json_arena* arena = NULL;
+#if ARENA_SIZE > 0
+        arena = &request_arena;
+#endif
+        struct netbuf* insitu;
+        struct json_lazy lazy;
+        struct request_line line;
+        bool over_budget;
+        struct json_value* json = receive_request(client, &insitu, arena, &lazy,
+                                                  &line, &over_budget);
+        if (line.target == TARGET_QUERY) {
+            serve_query(client, &line, arena);
+            netconn_close(client);
+            netconn_delete(client);
+            if (arena != NULL)
+                json_arena_reset(arena);
             continue;
         }
-
-        /* skip lines until message body */
-        /* TODO: Use proper HTTP parsing once the parser library is implemented */
-        size_t offset = 0;
-        for (size_t i = 0; i < 7; i++) {
-            while (offset < (size_t) bytes && recvbuf[offset] != '\n') {
-                offset++;
-            }
-            offset++;
-        }
-        char* data = &recvbuf[offset];
-        size_t len = bytes - offset;
-        data[len] = '\0';
-        printf("message body:\n%s\n", data);
-        struct json_value* json = parse_json(data, len);
-        if (json->type != JSON_OBJECT) {
-            close(client);
-            free_json_value(json);
+#if CONFIG_LIBUKDIAGREST_SAMPLER
+        if (line.target == TARGET_SAMPLES) {
+            serve_samples(client, &line, arena);
+            netconn_close(client);
+            netconn_delete(client);
+            if (arena != NULL)
+                json_arena_reset(arena);
+            continue;
+        }
+        if (line.target == TARGET_SAMPLER) {
+            serve_sampler(client, &line, json, over_budget, arena);
+            netconn_close(client);
+            netconn_delete(client);
+            release_request(json, insitu, arena, &lazy);
+            if (arena != NULL)
+                json_arena_reset(arena);
+            continue;
+        }
+#endif
+        if (line.target == TARGET_RPC) {
+            serve_rpc(client, json, over_budget, arena);
+            netconn_close(client);
+            netconn_delete(client);
+            release_request(json, insitu, arena, &lazy);
+            if (arena != NULL)
+                json_arena_reset(arena);
+            continue;
+        }
+        if (line.target == TARGET_PREPARE && json->type == JSON_OBJECT) {
+            serve_prepare(client, json, &lazy, arena);
+            netconn_close(client);
+            netconn_delete(client);
+            release_request(json, insitu, arena, &lazy);
+            if (arena != NULL)
+                json_arena_reset(arena);
+            continue;
+        }
+        /* a selection that does not parse is turned away before any call */
+        struct json_value* outputs = NULL;
+        struct reply_options options = { NULL, 0, NULL, 0, NULL };
+        if (json->type == JSON_OBJECT && request_options(client, &line, arena, &options)) {
+            outputs = new_outputs(arena);
+            over_budget = outputs == NULL;
+        }
+        if (outputs == NULL) {
+            if (over_budget)
+                send_unavailable(client);
+            else if (json->type != JSON_OBJECT)
+                send_malformed(client);
+            netconn_close(client);
+            netconn_delete(client);
+            release_options(&options, arena);
+            release_request(json, insitu, arena, &lazy);
+            if (arena != NULL)
+                json_arena_reset(arena);
             continue;
         }
         
-        struct json_value* outputs = create_json_value(JSON_OBJECT);
-        for (struct json_object* obj = json->object; obj != NULL; obj = obj->next) {
+        /*
+         * Outputs are built in request order from the same memory as the
+         * request, their keys are borrowed from it. The request is released
+         * after serialization.
+         */
+        struct json_object** tail = &outputs->object;
+        bool malformed = false;
+        size_t member = 0;
+        current_arena = arena;
+        for (struct json_object* obj = json->object; obj != NULL; obj = obj->next, member++) {
             printf("function name: %s\n", obj->key);
-            // TODO: use obj->value to pass parameters
             struct json_value* result = NULL;
-            run_diag_function(obj->key, obj->value, &result);
-            json_object_insert(outputs, obj->key, result);
+            const struct registered_function* function = find_function(obj->key);
+            if (function != NULL) {
+                struct json_lazy_range* range =
+                    obj->value == NULL ? &lazy.ranges[member] : NULL;
+                if (call_function(function, obj->value, range, arena, &result)
+                    == CALL_NO_MEMORY) {
+                    over_budget = true;
+                    break;
+                }
+            } else {
+                /*
+                 * Lazily indexed parameters are parsed right before their
+                 * function runs. A malformed one ends the request like a
+                 * malformed body, the functions before it have run already.
+                 */
+                if (obj->value == NULL) {
+                    obj->value = json_lazy_value(&lazy, member);
+                    if (obj->value->type == JSON_ERROR) {
+                        over_budget = lazy.out_of_memory;
+                        malformed = !over_budget;
+                        break;
+                    }
+                }
+                run_diag_function(obj->key, obj->value, &result);
+            }
+            if (!aggregate_result(&options, obj->key, &result, arena)) {
+                over_budget = true;
+                break;
+            }
+            struct json_object* output = new_output(arena);
+            if (output == NULL) {
+                release_reply_result(&options, result, arena);
+                over_budget = true;
+                break;
+            }
+            output->key = obj->key;
+            output->value = result;
+            output->next = NULL;
+            *tail = output;
+            tail = &output->next;
+        }
+        current_arena = NULL;
+        json_index_clear();
+        /*
+         * Measure the body first so the reply is serialized once into a
+         * buffer of exactly the right size, behind a correct Content-Length
+         */
+        size_t size = 0;
+        char* sendbuf = NULL;
+        if (!over_budget && !malformed) {
+            size = json_measure_projected(outputs, options.fields);
+            sendbuf = reply_buffer(arena, size);
+            over_budget = sendbuf == NULL;
+        }
+        if (sendbuf != NULL) {
+            size_t header_size = snprintf(sendbuf, HEADER_MAX, header, size);
+            json_serialize_projected(&sendbuf[header_size], size + 1, outputs, options.fields);
+            printf("result: %s\n", &sendbuf[header_size]);
+            printf("size: %lu\n", size);
+            size += header_size;
         }
-        size_t size = to_json(buff, buff_len, outputs);
-        printf("result: %s\n", buff);
-        printf("size: %lu\n", size);
 
-        free_json_value(json);
-        free_json_value(outputs);
+        release_request(json, insitu, arena, &lazy);
+        release_outputs(outputs, &options, arena);
+        release_options(&options, arena);
+#if CONFIG_LIBUKDIAGREST_MEMORY_STATS
+        print_memory_stats(arena);
+#endif
 
 
 		/* Send reply */
-		n = write(client, &sendbuf[0], header_size + size);
-		if (n < 0)
+		if (over_budget)
+			send_unavailable(client);
+		else if (malformed)
+			send_malformed(client);
+		else if (netconn_write(client, sendbuf, size, NETCONN_COPY) != ERR_OK)
 			fprintf(stderr, "Failed to send a reply\n");
 		else
 			printf("Sent a reply\n");
+		if (arena == NULL || !json_arena_owns(arena, sendbuf))
+			json_buffer_put(sendbuf);
+		if (arena != NULL)
+			json_arena_reset(arena);
 
 		/* Close connection */
-		close(client);
+		netconn_close(client);
+		netconn_delete(client);
 	}
 
 out: